@@ -0,0 +1,152 @@
+/*
+ * AsyncBINWritter.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef ASYNCBINWRITTER_HPP_
+#define ASYNCBINWRITTER_HPP_
+
+#include <petscdmda.h>
+#include <petscsys.h>
+#include <string>
+#include <vector>
+
+#include "Grid.hpp"
+#include "Interface.hpp"
+#include "BINWritter.hpp"
+
+
+/// \brief Background writer of .data files, same format as BINWritter.
+///
+/// write() takes a snapshot of the owned block into one of two buffers and starts non-blocking
+/// collective MPI-IO on it, so the computation can change the interface right away. When both
+/// buffers are in flight, write() waits for the older one. fence() waits for all of them.
+///
+/// All ranks have to call write() and fence() in the same order, opening and closing
+/// the files is collective.
+class AsyncBINWritter {
+
+	struct Slot {
+		bool                   busy;
+		MPI_File               fh;
+		MPI_Datatype           filetype;
+		MPI_Request            request;
+		std::vector<PetscReal> buffer;
+
+		Slot() : busy(false) {};
+	};
+
+	Slot slots[2];
+	int  next;     ///< slot used by the next write
+
+	/// wait for the slot and close its file
+	void complete(Slot& slot);
+
+public:
+
+	AsyncBINWritter() : next(0) {};
+
+	~AsyncBINWritter() {
+		fence();
+	}
+
+	/// snapshot the data and start writing it into file.data
+	template <typename type, int dim>
+	void write(const Interface<type, dim>& data, const char* file);
+
+	/// let the pending writes progress, returns true when nothing is pending
+	bool progress();
+
+	/// wait until all started writes are on the disk
+	void fence();
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+template <typename type, int dim>
+void AsyncBINWritter::write(const Interface<type, dim>& data, const char* file) {
+
+	int rank;
+	const Grid<type, dim>& gr = data.getGrid();
+	Slot& slot = slots[next];
+
+	MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+
+	// both buffers in flight, the older one has to go first
+	if ( slot.busy )
+		complete(slot);
+
+	std::string fname_d(file);
+
+	fname_d += ".data";
+
+	data.getOwnedData(slot.buffer);
+	slot.filetype = gr.createOwnedSubarrayType();
+
+	MPI_File_open(PETSC_COMM_WORLD, &fname_d[0], MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &slot.fh);
+	MPI_File_set_size(slot.fh, 0);
+
+	// set_view must not see a pending request on the file, the small header is written blocking
+	if (rank == 0) {
+		char header[BINWritter::headerSize];
+		BINWritter::packHeader(gr, header);
+		MPI_File_write_at(slot.fh, 0, header, BINWritter::headerSize, MPI_BYTE, MPI_STATUS_IGNORE);
+	}
+
+	MPI_File_set_view(slot.fh, BINWritter::headerSize, MPI_DOUBLE, slot.filetype, "native", MPI_INFO_NULL);
+	MPI_File_iwrite_at_all(slot.fh, 0, slot.buffer.data(), slot.buffer.size(), MPI_DOUBLE, &slot.request);
+
+	slot.busy = true;
+	next      = 1 - next;
+
+}
+
+inline void AsyncBINWritter::complete(Slot& slot) {
+
+	MPI_Wait(&slot.request, MPI_STATUS_IGNORE);
+
+	MPI_File_close(&slot.fh);
+	MPI_Type_free(&slot.filetype);
+
+	slot.busy = false;
+
+}
+
+inline bool AsyncBINWritter::progress() {
+
+	bool done = true;
+
+	for (int s = 0; s < 2; ++s) {
+		if ( !slots[s].busy )
+			continue;
+
+		// MPI_Test drives the IO of implementations without progress thread, the file stays open
+		// until fence or reuse of the slot, closing it is collective
+		int flag;
+		MPI_Test(&slots[s].request, &flag, MPI_STATUS_IGNORE);
+		if ( !flag )
+			done = false;
+	}
+
+	return done;
+
+}
+
+inline void AsyncBINWritter::fence() {
+
+	// older slot first, so files are closed in the order they were opened on all ranks
+	for (int s = 0; s < 2; ++s) {
+		Slot& slot = slots[(next + s) % 2];
+		if ( slot.busy )
+			complete(slot);
+	}
+
+}
+
+#endif /* ASYNCBINWRITTER_HPP_ */
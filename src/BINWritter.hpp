@@ -13,41 +13,108 @@
 #include <petscsys.h>
 #include <petscviewer.h>
 #include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
 
 #include "Grid.hpp"
 #include "Interface.hpp"
+#include "SlabGather.hpp"
 
 
 
+/// Writes the interface into .data file: int dim, int dims[3], double dx[3], bl[3], tr[3]
+/// followed by the values in natural order (x fastest).
+///
+/// All ranks write their owned block at once with collective MPI-IO, the file view of each rank
+/// is the subarray of its block. Nothing is gathered, memory needed is the size of the local block.
+///
+/// writeDataSerial() writes the same file by rank 0 alone, for file systems where MPI-IO
+/// does not work well. The grid comes to rank 0 in slabs, see SlabGather.
 class BINWritter {
+
+	/// appends the slabs to the open file
+	struct SlabSink {
+		FILE*    fp;
+		long int planeSize;
+
+		void operator()(int k0, int k1, const PetscReal* values);
+	};
+
 public:
+
+	/// size of the .data header in bytes
+	static const MPI_Offset headerSize = sizeof(int) + 3*sizeof(int) + 9*sizeof(double);
+
+	/// pack the .data header into buffer of headerSize bytes
+	static void packHeader(const int dims[3], const double dx[3], const double bl[3], const double tr[3], char* buffer) {
+
+		int d = 3;
+
+		char* pos = buffer;
+		memcpy(pos, &d, sizeof(int));         pos += sizeof(int);
+		memcpy(pos, dims, 3*sizeof(int));     pos += 3*sizeof(int);
+		memcpy(pos, dx, 3*sizeof(double));    pos += 3*sizeof(double);
+		memcpy(pos, bl, 3*sizeof(double));    pos += 3*sizeof(double);
+		memcpy(pos, tr, 3*sizeof(double));
+
+	}
+
+	/// pack the .data header of the grid into buffer of headerSize bytes
+	template <typename type, int dim>
+	static void packHeader(const Grid<type, dim>& gr, char* buffer) {
+
+		int dims[3]  = {gr.getM(0)  , gr.getM(1)  , gr.getM(2)};
+		double dx[3] = {gr.getDx(0) , gr.getDx(1) , gr.getDx(2)};
+		double bl[3] = {gr.getMin(0), gr.getMin(1), gr.getMin(2)};
+		double tr[3] = {gr.getMax(0), gr.getMax(1), gr.getMax(2)};
+
+		packHeader(dims, dx, bl, tr, buffer);
+
+	}
+
 	template <typename type, int dim>
 	static void writeData(const Interface<type, dim>& data, char* file) {
 
 		int rank;
 		const Grid<type, dim>& gr = data.getGrid();
-		const DMDALocalInfo* info = gr.getLocalInfo();
 
+		MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+
+		std::string fname_d(file);
 
-		long int length = gr.getM(0) * gr.getM(1) * gr.getM(2);
+		fname_d += ".data";
 
+		std::vector<PetscReal> owned;
+		data.getOwnedData(owned);
 
-		Vec        glob, seq;
-		VecScatter tolocalall, fromlocalall, sc;
+		MPI_File     fh;
+		MPI_Status   status;
+		MPI_Datatype filetype = gr.createOwnedSubarrayType();
 
-		DMCreateGlobalVector(info->da, &glob);
+		MPI_File_open(PETSC_COMM_WORLD, &fname_d[0], MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+		MPI_File_set_size(fh, 0); // older and larger file would leave its tail behind
 
+		if (rank == 0) {
+			char header[headerSize];
+			packHeader(gr, header);
+			MPI_File_write_at(fh, 0, header, headerSize, MPI_BYTE, &status);
+		}
 
-		DMDAGlobalToNaturalAllCreate(info->da, &tolocalall);
+		MPI_File_set_view(fh, headerSize, MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
+		MPI_File_write_at_all(fh, 0, owned.data(), owned.size(), MPI_DOUBLE, &status);
 
-		DMLocalToGlobalBegin(info->da, data.getLocalData(), INSERT_VALUES, glob);
-		DMLocalToGlobalEnd(info->da, data.getLocalData(), INSERT_VALUES, glob);
+		MPI_File_close(&fh);
+		MPI_Type_free(&filetype);
 
-		VecCreateSeq(PETSC_COMM_SELF, length, &seq);
+	}
 
-		VecScatterBegin(tolocalall, glob, seq, INSERT_VALUES, SCATTER_FORWARD);
-		VecScatterEnd(tolocalall, glob, seq, INSERT_VALUES, SCATTER_FORWARD);
+	/// \param slabBudget memory of rank 0 for the slabs in bytes
+	template <typename type, int dim>
+	static void writeDataSerial(const Interface<type, dim>& data, char* file, long int slabBudget = SlabGather::defaultBudget) {
 
+		int rank;
+		const Grid<type, dim>& gr = data.getGrid();
 
 		MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
 
@@ -55,35 +122,30 @@ public:
 
 		fname_d += ".data";
 
-		if (rank == 0) {
-			int d = dim;
-			int dims[dim]  = {gr.getM(0)  , gr.getM(1)  , gr.getM(2)};
-			double bl[dim] = {gr.getMin(0), gr.getMin(1), gr.getMin(2)};
-			double tr[dim] = {gr.getMax(0), gr.getMax(1), gr.getMax(2)};
-			double dx[dim] = {gr.getDx(0) , gr.getDx(1) , gr.getDx(2)};
-
-			FILE *fp;
-
-			fp = fopen(&fname_d[0], "w");
-
-			double * data;
-			VecGetArray(seq, &data);
+		SlabSink sink = {NULL, long(gr.getM(0)) * gr.getM(1)};
 
-			fwrite(&d, sizeof(int), 1, fp);
-			fwrite(dims, sizeof(int), 3, fp);
-			fwrite(dx, sizeof(double), 3, fp);
-			fwrite(bl, sizeof(double), 3, fp);
-			fwrite(tr, sizeof(double), 3, fp);
-			fwrite(data, sizeof(double), length, fp);
+		if (rank == 0) {
+			char header[headerSize];
+			packHeader(gr, header);
 
-			fclose(fp);
+			sink.fp = fopen(&fname_d[0], "wb");
+			fwrite(header, 1, headerSize, sink.fp);
+		}
 
-			VecRestoreArray(seq, &data);
+		SlabGather::gather(data, sink, slabBudget);
 
+		if (rank == 0) {
+			fclose(sink.fp);
 		}
 
 	}
 
 };
 
+inline void BINWritter::SlabSink::operator()(int k0, int k1, const PetscReal* values) {
+
+	fwrite(values, sizeof(PetscReal), (k1 - k0) * planeSize, fp);
+
+}
+
 #endif /* BINWRITTER_HPP_ */
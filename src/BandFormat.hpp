@@ -0,0 +1,186 @@
+/*
+ * BandFormat.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef BANDFORMAT_HPP_
+#define BANDFORMAT_HPP_
+
+#include <stdint.h>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <zlib.h>
+
+
+/// Layout of the .band file, the narrow band output written by BandWritter and read by BandReader.
+///
+///   BandFileHeader
+///   BandRankEntry    x nRanks      owned box of every rank and where its brick table is
+///   BandBrickEntry   x nBricks     brick tables of all ranks, one after another in rank order
+///   payloads                       values of the band bricks, one after another in rank order
+///
+/// The owned box of a rank is split into bricks of brickSize^3 cells aligned to the box origin,
+/// the bricks on the upper side may be smaller. Bricks are numbered x fastest, cells in the brick
+/// are stored x fastest too. Brick with no cell closer than bandWidth to the interface has no payload,
+/// only its coarse signed distance in units of dx is kept in the table.
+///
+/// Payload of a band brick is either the raw doubles or the doubles quantized to 16 bit fixed
+/// point around the middle of the brick range, payload starts with the double quantization step
+/// and the double offset then. Both may be deflated by zlib.
+///
+/// Everything is stored in the native byte order, as in .data files.
+
+static const char    bandMagic[8]   = {'L', 'S', 'B', 'A', 'N', 'D', '0', '1'};
+static const int     bandBrickSize  = 8;
+
+/// payload of the brick
+enum BandBrickFlags {
+	BRICK_FAR     = 0, ///< no payload, the brick is represented by the coarse value
+	BRICK_RAW     = 1, ///< payload are the doubles of the brick
+	BRICK_ZLIB    = 2, ///< payload is deflated
+	BRICK_QUANT16 = 4  ///< payload is the step and the offset followed by int16 multiples of the step
+};
+
+/// how BandWritter stores the band bricks
+enum BandCompression {
+	BAND_RAW          = 0,                          ///< doubles as they are
+	BAND_ZLIB         = BRICK_ZLIB,                 ///< lossless
+	BAND_QUANT16      = BRICK_QUANT16,              ///< error bounded, 4x smaller
+	BAND_QUANT16_ZLIB = BRICK_QUANT16 | BRICK_ZLIB
+};
+
+struct BandFileHeader {
+	char    magic[8];
+	int32_t dim;
+	int32_t dims[3];
+	double  dx[3];
+	double  bl[3];
+	double  tr[3];
+	double  bandWidth; ///< in units of the smallest dx
+	int32_t brickSize;
+	int32_t nRanks;
+};
+
+struct BandRankEntry {
+	int32_t lo[3];       ///< first owned cell
+	int32_t size[3];     ///< number of owned cells
+	int64_t tableOffset; ///< file offset of the brick table
+	int64_t nBricks;
+};
+
+struct BandBrickEntry {
+	int64_t  offset;      ///< file offset of the payload
+	int32_t  payloadSize; ///< in bytes
+	int16_t  coarse;      ///< signed distance of the brick closest to the interface, in units of dx
+	uint16_t flags;       ///< BandBrickFlags
+};
+
+static_assert(sizeof(BandFileHeader) == 112, "BandFileHeader must not be padded");
+static_assert(sizeof(BandRankEntry)  == 40,  "BandRankEntry must not be padded");
+static_assert(sizeof(BandBrickEntry) == 16,  "BandBrickEntry must not be padded");
+
+
+/// number of bricks covering the box along each dimension, returns their total count
+inline long int bandBrickCounts(const int32_t size[3], int nb[3]) {
+
+	for (int d = 0; d < 3; ++d) {
+		nb[d] = (size[d] + bandBrickSize - 1) / bandBrickSize;
+	}
+
+	return long(nb[0]) * nb[1] * nb[2];
+
+}
+
+inline int16_t bandQuantizeCoarse(double value, double dx) {
+
+	double q = value / dx;
+	if ( q >  32767 ) return  32767;
+	if ( q < -32767 ) return -32767;
+
+	return int16_t( q < 0 ? q - 0.5 : q + 0.5 );
+
+}
+
+/// encode values of the brick, flags of the brick are returned
+/// \param step   quantization step, used by BAND_QUANT16 modes only
+/// \param offset value stored as zero, values have to be within 32767 steps of it
+inline uint16_t bandEncodeBrick(const double* values, long int numberOfCells, int compression, double step, double offset,
+                                std::vector<char>& out) {
+
+	uint16_t         flags = BRICK_RAW;
+	std::vector<char> plain;
+
+	if ( compression & BRICK_QUANT16 ) {
+		flags |= BRICK_QUANT16;
+		plain.resize( 2*sizeof(double) + numberOfCells*sizeof(int16_t) );
+		memcpy(&plain[0], &step, sizeof(double));
+		memcpy(&plain[sizeof(double)], &offset, sizeof(double));
+
+		int16_t* q = (int16_t*)&plain[2*sizeof(double)];
+		for (long int c = 0; c < numberOfCells; ++c) {
+			double v = (values[c] - offset) / step;
+			if ( v >  32767 ) v =  32767;
+			if ( v < -32767 ) v = -32767;
+			q[c] = int16_t( v < 0 ? v - 0.5 : v + 0.5 );
+		}
+	} else {
+		plain.assign( (const char*)values, (const char*)(values + numberOfCells) );
+	}
+
+	if ( compression & BRICK_ZLIB ) {
+		uLongf deflated = compressBound(plain.size());
+		out.resize(deflated);
+
+		// incompressible bricks are kept as they are
+		if ( compress2((Bytef*)&out[0], &deflated, (const Bytef*)&plain[0], plain.size(), Z_DEFAULT_COMPRESSION) == Z_OK
+				&& deflated < plain.size() ) {
+			out.resize(deflated);
+			return flags | BRICK_ZLIB;
+		}
+	}
+
+	out.swap(plain);
+
+	return flags;
+
+}
+
+/// decode payload of the brick with given flags into numberOfCells values
+inline bool bandDecodeBrick(const char* payload, long int payloadSize, uint16_t flags, long int numberOfCells, double* values) {
+
+	long int          plainSize = (flags & BRICK_QUANT16) ? 2*sizeof(double) + numberOfCells*sizeof(int16_t)
+	                                                      : numberOfCells*sizeof(double);
+	std::vector<char> inflated;
+	const char*       plain = payload;
+
+	if ( flags & BRICK_ZLIB ) {
+		uLongf size = plainSize;
+		inflated.resize(plainSize);
+		if ( uncompress((Bytef*)&inflated[0], &size, (const Bytef*)payload, payloadSize) != Z_OK || long(size) != plainSize )
+			return false;
+		plain = &inflated[0];
+	} else if ( payloadSize != plainSize ) {
+		return false;
+	}
+
+	if ( flags & BRICK_QUANT16 ) {
+		double step, offset;
+		memcpy(&step, plain, sizeof(double));
+		memcpy(&offset, plain + sizeof(double), sizeof(double));
+
+		const int16_t* q = (const int16_t*)(plain + 2*sizeof(double));
+		for (long int c = 0; c < numberOfCells; ++c) {
+			values[c] = offset + q[c] * step;
+		}
+	} else {
+		memcpy(values, plain, plainSize);
+	}
+
+	return true;
+
+}
+
+#endif /* BANDFORMAT_HPP_ */
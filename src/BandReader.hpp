@@ -0,0 +1,240 @@
+/*
+ * BandReader.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef BANDREADER_HPP_
+#define BANDREADER_HPP_
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "BandFormat.hpp"
+
+
+/// \brief Serial reader of the .band files written by BandWritter.
+///
+/// Only the header and the rank table are read when the file is opened. readBox() then reads
+/// just the brick tables of the ranks covering the box and the payloads of the bricks it touches.
+/// Far bricks are filled by their coarse value, compressed bricks are decoded. No MPI or PETSc
+/// is needed, so the reader can be used by the post processing tools.
+class BandReader {
+
+	FILE*                                     fp;
+	BandFileHeader                            header;
+	std::vector<BandRankEntry>                ranks;
+	std::vector< std::vector<BandBrickEntry> > tables; ///< brick tables, read on first use
+
+	/// brick table of the rank, NULL when it can not be read
+	const std::vector<BandBrickEntry>* getTable(int r);
+
+	/// decode the payload of the brick into values, false when the payload is short or corrupt
+	bool readBrick(const BandBrickEntry& entry, long int numberOfCells, std::vector<double>& values);
+
+public:
+
+	BandReader() : fp(NULL) {};
+
+	~BandReader() {
+		close();
+	}
+
+	/// open the file and read its header, returns false when it is not a .band file
+	bool open(const char* file);
+
+	void close();
+
+	int getM(int d) const {
+		return header.dims[d];
+	}
+
+	double getDx(int d) const {
+		return header.dx[d];
+	}
+
+	double getMin(int d) const {
+		return header.bl[d];
+	}
+
+	double getMax(int d) const {
+		return header.tr[d];
+	}
+
+	/// read the cells lo <= ind < hi into values stored x fastest,
+	/// false when the box is out of the grid or a table or a brick it touches can not be read
+	bool readBox(const int lo[3], const int hi[3], std::vector<double>& values);
+
+	/// read the whole grid in natural order, the same data as in .data file
+	bool readAll(std::vector<double>& values);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+inline bool BandReader::open(const char* file) {
+
+	close();
+
+	fp = fopen(file, "rb");
+	if ( fp == NULL )
+		return false;
+
+	if ( fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, bandMagic, sizeof(bandMagic)) != 0 ) {
+		close();
+		return false;
+	}
+
+	ranks.resize(header.nRanks);
+	if ( fread(ranks.data(), sizeof(BandRankEntry), header.nRanks, fp) != size_t(header.nRanks) ) {
+		close();
+		return false;
+	}
+
+	tables.assign(header.nRanks, std::vector<BandBrickEntry>());
+
+	return true;
+
+}
+
+inline void BandReader::close() {
+
+	if ( fp != NULL )
+		fclose(fp);
+
+	fp = NULL;
+	ranks.clear();
+	tables.clear();
+
+}
+
+inline const std::vector<BandBrickEntry>* BandReader::getTable(int r) {
+
+	std::vector<BandBrickEntry>& table = tables[r];
+
+	if ( table.empty() && ranks[r].nBricks > 0 ) {
+		table.resize(ranks[r].nBricks);
+		if ( fseek(fp, ranks[r].tableOffset, SEEK_SET) != 0
+				|| fread(table.data(), sizeof(BandBrickEntry), table.size(), fp) != table.size() ) {
+			table.clear();
+			return NULL;
+		}
+	}
+
+	return &table;
+
+}
+
+inline bool BandReader::readBrick(const BandBrickEntry& entry, long int numberOfCells, std::vector<double>& values) {
+
+	values.resize(numberOfCells);
+
+	if ( entry.flags == BRICK_FAR ) {
+		double dxMin = std::min(header.dx[0], std::min(header.dx[1], header.dx[2]));
+		std::fill(values.begin(), values.end(), entry.coarse * dxMin);
+		return true;
+	}
+
+	// zero is the interface, a brick that can not be read must not come back as one
+	std::vector<char> payload(entry.payloadSize);
+
+	return fseek(fp, entry.offset, SEEK_SET) == 0
+	       && fread(payload.data(), 1, payload.size(), fp) == payload.size()
+	       && bandDecodeBrick(payload.data(), payload.size(), entry.flags, numberOfCells, values.data());
+
+}
+
+inline bool BandReader::readBox(const int lo[3], const int hi[3], std::vector<double>& values) {
+
+	if ( fp == NULL )
+		return false;
+
+	int m[3];
+	for (int d = 0; d < 3; ++d) {
+		if ( lo[d] < 0 || hi[d] > header.dims[d] || lo[d] >= hi[d] )
+			return false;
+		m[d] = hi[d] - lo[d];
+	}
+
+	values.assign(long(m[0]) * m[1] * m[2], 0.0);
+
+	std::vector<double> brick;
+
+	for (int r = 0; r < header.nRanks; ++r) {
+		const BandRankEntry& rk = ranks[r];
+
+		// part of the box owned by this rank
+		int rlo[3], rhi[3];
+		bool overlap = true;
+		for (int d = 0; d < 3; ++d) {
+			rlo[d] = std::max(lo[d], rk.lo[d]);
+			rhi[d] = std::min(hi[d], rk.lo[d] + rk.size[d]);
+			overlap = overlap && rlo[d] < rhi[d];
+		}
+		if ( !overlap )
+			continue;
+
+		const std::vector<BandBrickEntry>* table = getTable(r);
+		if ( table == NULL || long(table->size()) != rk.nBricks )
+			return false;
+
+		int nb[3];
+		bandBrickCounts(rk.size, nb);
+
+		// bricks touched by the overlap, in brick coordinates of the rank
+		int blo[3], bhi[3];
+		for (int d = 0; d < 3; ++d) {
+			blo[d] = (rlo[d] - rk.lo[d]) / header.brickSize;
+			bhi[d] = (rhi[d] - 1 - rk.lo[d]) / header.brickSize;
+		}
+
+		for (int bk = blo[2]; bk <= bhi[2]; ++bk) {
+			for (int bj = blo[1]; bj <= bhi[1]; ++bj) {
+				for (int bi = blo[0]; bi <= bhi[0]; ++bi) {
+					int b[3] = {bi, bj, bk};
+					int clo[3], csize[3];
+					for (int d = 0; d < 3; ++d) {
+						clo[d]   = rk.lo[d] + b[d]*header.brickSize;
+						csize[d] = std::min(int(header.brickSize), int(rk.lo[d] + rk.size[d] - clo[d]));
+					}
+
+					const BandBrickEntry& entry = (*table)[ bi + bj*long(nb[0]) + bk*long(nb[0])*nb[1] ];
+					if ( !readBrick(entry, long(csize[0]) * csize[1] * csize[2], brick) )
+						return false;
+
+					// copy the intersection of the brick and the box
+					for (int k = std::max(clo[2], rlo[2]); k < std::min(clo[2] + csize[2], rhi[2]); ++k) {
+						for (int j = std::max(clo[1], rlo[1]); j < std::min(clo[1] + csize[1], rhi[1]); ++j) {
+							int i0 = std::max(clo[0], rlo[0]);
+							int i1 = std::min(clo[0] + csize[0], rhi[0]);
+
+							const double* src = &brick[ (i0 - clo[0]) + (j - clo[1])*long(csize[0]) + (k - clo[2])*long(csize[0])*csize[1] ];
+							double*       dst = &values[ (i0 - lo[0]) + (j - lo[1])*long(m[0]) + (k - lo[2])*long(m[0])*m[1] ];
+							std::copy(src, src + (i1 - i0), dst);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+
+}
+
+inline bool BandReader::readAll(std::vector<double>& values) {
+
+	int lo[3] = {0, 0, 0};
+	int hi[3] = {header.dims[0], header.dims[1], header.dims[2]};
+
+	return readBox(lo, hi, values);
+
+}
+
+#endif /* BANDREADER_HPP_ */
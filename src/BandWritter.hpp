@@ -0,0 +1,384 @@
+/*
+ * BandWritter.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef BANDWRITTER_HPP_
+#define BANDWRITTER_HPP_
+
+#include <petscdmda.h>
+#include <petscsys.h>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "Grid.hpp"
+#include "Interface.hpp"
+#include "BandFormat.hpp"
+#include "SparseGrid.hpp"
+#include "ThreadPool.hpp"
+
+
+/// \brief Writes the narrow band of the interface into .band file, see BandFormat.hpp.
+///
+/// Every rank splits its owned block into bricks, only the bricks touching the band carry
+/// their values. Offsets of the ranks in the file are found by prefix sums, so all ranks
+/// write their brick tables and payloads at once with collective MPI-IO.
+///
+/// Payloads of the band bricks can be deflated (lossless) or quantized to 16 bit with
+/// bounded error, each rank compresses its own bricks, the threads of the pool share them.
+class BandWritter {
+
+	/// cells of the brick, x fastest, taken from the owned block
+	static void copyBrick(const std::vector<PetscReal>& owned, const int32_t size[3],
+	                      const int lo[3], const int hi[3], std::vector<PetscReal>& brick);
+
+	/// quantization step keeping maxError, values up to range from the offset have to fit into 16 bits
+	static double quantizationStep(double range, double dxMin, double maxError);
+
+	/// table entry of the brick, the payload is encoded when a cell is closer than threshold.
+	/// The step is chosen from the range of the brick, a brick needing a step coarser than maxStep
+	/// is stored lossless.
+	static void packBrick(const std::vector<PetscReal>& brick, double threshold, double dxMin, int compression,
+	                      double maxError, double maxStep, BandBrickEntry& entry, std::vector<char>& encoded);
+
+	/// concatenates the payloads of the bricks in their order, offsets are relative to the rank payload
+	static void joinPayloads(std::vector<BandBrickEntry>& table, std::vector< std::vector<char> >& encoded,
+	                         std::vector<char>& payload);
+
+	/// collective write of bytes at offset, MPI counts are int, so large buffers go in blocks,
+	/// all ranks make the same number of calls
+	static void writeAtAll(MPI_File fh, long long offset, const char* data, long long bytes);
+
+	/// places the ranks in the file and writes it, header is completed here
+	static void writeFile(const std::string& fname, BandFileHeader& header, BandRankEntry& me,
+	                      std::vector<BandBrickEntry>& table, const std::vector<char>& payload);
+
+public:
+
+	/// \param bandWidth   bricks with a cell closer than bandWidth*dx to the interface are stored with all values
+	/// \param compression BandCompression of the band bricks
+	/// \param maxError    largest error of the quantized values, zero means 1e-4*dx. The step grows
+	///                    when 16 bits can not span the band with it, bricks whose values do not fit
+	///                    into 16 bits of that step are stored lossless.
+	/// \param pool        threads packing the bricks, NULL packs them on the calling thread
+	template <typename type, int dim>
+	static void writeData(const Interface<type, dim>& data, char* file, double bandWidth = 3,
+	                      int compression = BAND_RAW, double maxError = 0, ThreadPool* pool = NULL);
+
+	/// the same file from the sparse grid, every rank writes the bricks it owns. Tiles are far bricks
+	/// with the background as their coarse value, the leaves are classified as the dense bricks are.
+	static void writeData(const SparseGrid& grid, char* file, double bandWidth = 3,
+	                      int compression = BAND_RAW, double maxError = 0, ThreadPool* pool = NULL);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+inline void BandWritter::copyBrick(const std::vector<PetscReal>& owned, const int32_t size[3],
+                                   const int lo[3], const int hi[3], std::vector<PetscReal>& brick) {
+
+	brick.clear();
+
+	for (int k = lo[2]; k < hi[2]; ++k) {
+		for (int j = lo[1]; j < hi[1]; ++j) {
+			const PetscReal* row = &owned[ lo[0] + j*long(size[0]) + k*long(size[0])*size[1] ];
+			brick.insert(brick.end(), row, row + (hi[0] - lo[0]));
+		}
+	}
+
+}
+
+inline double BandWritter::quantizationStep(double range, double dxMin, double maxError) {
+
+	// rounding error is half of the step
+	if ( maxError <= 0 )
+		maxError = 1E-4 * dxMin;
+
+	return std::max(2.0 * maxError, range / 32767.0);
+
+}
+
+inline void BandWritter::packBrick(const std::vector<PetscReal>& brick, double threshold, double dxMin, int compression,
+                                   double maxError, double maxStep, BandBrickEntry& entry, std::vector<char>& encoded) {
+
+	double closest = brick[0];
+	double lowest  = brick[0], highest = brick[0];
+	for (size_t c = 1; c < brick.size(); ++c) {
+		if ( std::abs(brick[c]) < std::abs(closest) )
+			closest = brick[c];
+		lowest  = std::min(lowest, brick[c]);
+		highest = std::max(highest, brick[c]);
+	}
+
+	entry.coarse = bandQuantizeCoarse(closest, dxMin);
+
+	if ( std::abs(closest) < threshold ) {
+		// cells of the brick reach farther than the band, the whole range of the brick has to fit,
+		// nothing is clamped by the quantization
+		double offset = 0.5 * (lowest + highest);
+		double step   = quantizationStep(0.5 * (highest - lowest), dxMin, maxError);
+		if ( !(step <= maxStep) )
+			compression &= ~BRICK_QUANT16;
+
+		entry.flags       = bandEncodeBrick(brick.data(), brick.size(), compression, step, offset, encoded);
+		entry.offset      = 0;
+		entry.payloadSize = encoded.size();
+	} else {
+		entry.offset      = 0;
+		entry.payloadSize = 0;
+		entry.flags       = BRICK_FAR;
+	}
+
+}
+
+inline void BandWritter::joinPayloads(std::vector<BandBrickEntry>& table, std::vector< std::vector<char> >& encoded,
+                                      std::vector<char>& payload) {
+
+	long long size = 0;
+	for (size_t b = 0; b < encoded.size(); ++b) {
+		size += encoded[b].size();
+	}
+
+	payload.clear();
+	payload.reserve(size);
+
+	for (size_t b = 0; b < table.size(); ++b) {
+		if ( table[b].flags == BRICK_FAR )
+			continue;
+
+		table[b].offset = payload.size();
+		payload.insert(payload.end(), encoded[b].begin(), encoded[b].end());
+		std::vector<char>().swap(encoded[b]);
+	}
+
+}
+
+inline void BandWritter::writeAtAll(MPI_File fh, long long offset, const char* data, long long bytes) {
+
+	const long long block = 1LL << 30;
+
+	long long blocks = (bytes + block - 1) / block, allBlocks = 0;
+	MPI_Allreduce(&blocks, &allBlocks, 1, MPI_LONG_LONG, MPI_MAX, PETSC_COMM_WORLD);
+
+	MPI_Status status;
+
+	for (long long b = 0; b < allBlocks; ++b) {
+		long long first = std::min(b * block, bytes);
+		int       count = std::min(block, bytes - first);
+		MPI_File_write_at_all(fh, offset + first, const_cast<char*>(data) + first, count, MPI_BYTE, &status);
+	}
+
+}
+
+inline void BandWritter::writeFile(const std::string& fname, BandFileHeader& header, BandRankEntry& me,
+                                   std::vector<BandBrickEntry>& table, const std::vector<char>& payload) {
+
+	int rank, nRanks;
+
+	MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+	MPI_Comm_size(PETSC_COMM_WORLD, &nRanks);
+
+	// place the ranks in the file
+	long long tableBytes   = table.size() * sizeof(BandBrickEntry);
+	long long payloadBytes = payload.size();
+	long long tableStart = 0, payloadStart = 0, allTables = 0;
+
+	MPI_Exscan(&tableBytes, &tableStart, 1, MPI_LONG_LONG, MPI_SUM, PETSC_COMM_WORLD);
+	MPI_Exscan(&payloadBytes, &payloadStart, 1, MPI_LONG_LONG, MPI_SUM, PETSC_COMM_WORLD);
+	MPI_Allreduce(&tableBytes, &allTables, 1, MPI_LONG_LONG, MPI_SUM, PETSC_COMM_WORLD);
+
+	if (rank == 0) {
+		// result of exscan is undefined on the first rank
+		tableStart   = 0;
+		payloadStart = 0;
+	}
+
+	long long headerBytes = sizeof(BandFileHeader) + nRanks * sizeof(BandRankEntry);
+
+	me.tableOffset = headerBytes + tableStart;
+	payloadStart  += headerBytes + allTables;
+
+	for (size_t i = 0; i < table.size(); ++i) {
+		if ( table[i].flags != BRICK_FAR )
+			table[i].offset += payloadStart;
+	}
+
+	std::vector<BandRankEntry> ranks(rank == 0 ? nRanks : 0);
+	MPI_Gather(&me, sizeof(BandRankEntry), MPI_BYTE, ranks.data(), sizeof(BandRankEntry), MPI_BYTE, 0, PETSC_COMM_WORLD);
+
+	MPI_File   fh;
+	MPI_Status status;
+
+	MPI_File_open(PETSC_COMM_WORLD, const_cast<char*>(fname.c_str()), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+	MPI_File_set_size(fh, 0);
+
+	if (rank == 0) {
+		memcpy(header.magic, bandMagic, sizeof(bandMagic));
+		header.brickSize = bandBrickSize;
+		header.nRanks    = nRanks;
+
+		MPI_File_write_at(fh, 0, &header, sizeof(header), MPI_BYTE, &status);
+		MPI_File_write_at(fh, sizeof(header), ranks.data(), nRanks * sizeof(BandRankEntry), MPI_BYTE, &status);
+	}
+
+	writeAtAll(fh, me.tableOffset, (const char*)table.data(), tableBytes);
+	writeAtAll(fh, payloadStart, payload.data(), payloadBytes);
+
+	MPI_File_close(&fh);
+
+}
+
+template <typename type, int dim>
+void BandWritter::writeData(const Interface<type, dim>& data, char* file, double bandWidth,
+                            int compression, double maxError, ThreadPool* pool) {
+
+	const Grid<type, dim>& gr   = data.getGrid();
+	const DMDALocalInfo*   info = gr.getLocalInfo();
+
+	std::string fname_d(file);
+
+	fname_d += ".band";
+
+	double dxMin     = std::min(gr.getDx(0), std::min(gr.getDx(1), gr.getDx(2)));
+	double threshold = bandWidth * dxMin;
+	double maxStep   = quantizationStep(threshold, dxMin, maxError);
+
+	std::vector<PetscReal> owned;
+	data.getOwnedData(owned);
+
+	BandRankEntry me;
+	me.lo[0]   = info->xs; me.lo[1]   = info->ys; me.lo[2]   = info->zs;
+	me.size[0] = info->xm; me.size[1] = info->ym; me.size[2] = info->zm;
+
+	int nb[3];
+	me.nBricks = bandBrickCounts(me.size, nb);
+
+	// classify the bricks and pack the payloads, the bricks are independent
+	std::vector<BandBrickEntry>      table(me.nBricks);
+	std::vector< std::vector<char> > encoded(me.nBricks);
+	std::vector<char>                payload;
+
+	ThreadPool::parallelFor(pool, 0, me.nBricks, 16, [&](long int first, long int last, int) {
+		std::vector<PetscReal> brick;
+
+		for (long int b = first; b < last; ++b) {
+			int bi = b % nb[0], bj = (b / nb[0]) % nb[1], bk = b / (long(nb[0]) * nb[1]);
+
+			int lo[3] = {bi*bandBrickSize, bj*bandBrickSize, bk*bandBrickSize};
+			int hi[3];
+			for (int d = 0; d < 3; ++d) {
+				hi[d] = std::min(lo[d] + bandBrickSize, int(me.size[d]));
+			}
+
+			copyBrick(owned, me.size, lo, hi, brick);
+			packBrick(brick, threshold, dxMin, compression, maxError, maxStep, table[b], encoded[b]);
+		}
+	} );
+
+	joinPayloads(table, encoded, payload);
+
+	BandFileHeader header;
+	header.dim       = dim;
+	for (int d = 0; d < 3; ++d) {
+		header.dims[d] = gr.getM(d);
+		header.dx[d]   = gr.getDx(d);
+		header.bl[d]   = gr.getMin(d);
+		header.tr[d]   = gr.getMax(d);
+	}
+	header.bandWidth = bandWidth;
+
+	writeFile(fname_d, header, me, table, payload);
+
+}
+
+inline void BandWritter::writeData(const SparseGrid& grid, char* file, double bandWidth,
+                                   int compression, double maxError, ThreadPool* pool) {
+
+	const int bs = SparseGrid::brickSize;
+
+	std::string fname_d(file);
+
+	fname_d += ".band";
+
+	double dxMin     = std::min(grid.getDx(0), std::min(grid.getDx(1), grid.getDx(2)));
+	double threshold = bandWidth * dxMin;
+	double maxStep   = quantizationStep(threshold, dxMin, maxError);
+
+	// owned bricks start on a brick of the grid, so they are the bricks of the file
+	int ownedLo[3], ownedHi[3];
+	grid.getOwnedBricks(ownedLo, ownedHi);
+
+	BandRankEntry me;
+	for (int d = 0; d < 3; ++d) {
+		me.lo[d]   = long(ownedLo[d]) * bs;
+		me.size[d] = std::max(std::min(long(ownedHi[d]) * bs, grid.getM(d)) - me.lo[d], 0L);
+	}
+
+	int nb[3];
+	me.nBricks = bandBrickCounts(me.size, nb);
+
+	std::vector<BandBrickEntry>      table(me.nBricks);
+	std::vector< std::vector<char> > encoded(me.nBricks);
+	std::vector<char>                payload;
+
+	ThreadPool::parallelFor(pool, 0, me.nBricks, 16, [&](long int first, long int last, int) {
+		std::vector<PetscReal> brick;
+
+		for (long int b = first; b < last; ++b) {
+			int bp[3] = {int(b % nb[0]), int((b / nb[0]) % nb[1]), int(b / (long(nb[0]) * nb[1]))};
+
+			int32_t e = grid.getEntry( grid.getTableIndex(ownedLo[0] + bp[0], ownedLo[1] + bp[1], ownedLo[2] + bp[2]) );
+
+			if ( e < 0 ) {
+				BandBrickEntry& entry = table[b];
+				entry.coarse      = bandQuantizeCoarse(e == SparseGrid::TILE_INSIDE ? -grid.getBackground() : grid.getBackground(), dxMin);
+				entry.offset      = 0;
+				entry.payloadSize = 0;
+				entry.flags       = BRICK_FAR;
+				continue;
+			}
+
+			// the leaves of the last bricks hold cells behind the last node
+			int hi[3];
+			for (int d = 0; d < 3; ++d) {
+				hi[d] = std::min(bs, int(me.size[d]) - bp[d] * bs);
+			}
+
+			const double* values = grid.getLeaf(e);
+			brick.clear();
+			for (int k = 0; k < hi[2]; ++k) {
+				for (int j = 0; j < hi[1]; ++j) {
+					const double* row = values + bs * (j + bs * k);
+					brick.insert(brick.end(), row, row + hi[0]);
+				}
+			}
+
+			packBrick(brick, threshold, dxMin, compression, maxError, maxStep, table[b], encoded[b]);
+		}
+	} );
+
+	joinPayloads(table, encoded, payload);
+
+	BandFileHeader header;
+	header.dim       = 3;
+	for (int d = 0; d < 3; ++d) {
+		header.dims[d] = grid.getM(d);
+		header.dx[d]   = grid.getDx(d);
+		header.bl[d]   = grid.getMin(d);
+		header.tr[d]   = grid.getMax(d);
+	}
+	header.bandWidth = bandWidth;
+
+	writeFile(fname_d, header, me, table, payload);
+
+}
+
+#endif /* BANDWRITTER_HPP_ */
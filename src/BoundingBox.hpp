@@ -58,6 +58,19 @@ struct Box {
 
 	}
 
+	Box<type, dim>& operator=(const Box<type, dim>& b) {
+
+		for (int i = 0; i < dim; ++i) {
+
+			_bl[i] = b._bl[i];
+			_tr[i] = b._tr[i];
+
+		}
+
+		return *this;
+
+	}
+
 	Box(const type minx[dim], const type maxx[dim]) {
 
 		for (int i = 0; i < dim; ++i) {
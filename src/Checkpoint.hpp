@@ -0,0 +1,231 @@
+/*
+ * Checkpoint.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef CHECKPOINT_HPP_
+#define CHECKPOINT_HPP_
+
+#include <petscdmda.h>
+#include <petscsys.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cmath>
+
+#include "Grid.hpp"
+#include "Interface.hpp"
+
+
+/// header of the .ckpt file
+struct CheckpointHeader {
+	char    magic[8];
+	int32_t dim;
+	int32_t dims[3];   ///< number of nodes
+	double  bl[3];
+	double  tr[3];
+	int32_t nRanks;    ///< number of ranks which wrote the checkpoint
+	int32_t procs[3];  ///< their layout
+	int64_t dataOffset;
+};
+
+/// owned box of one rank, in natural indices
+struct CheckpointBlock {
+	int32_t lo[3];
+	int32_t size[3];
+};
+
+static_assert(sizeof(CheckpointHeader) == 96, "CheckpointHeader must not be padded");
+
+static const char checkpointMagic[8] = {'L', 'S', 'C', 'K', 'P', 'T', '0', '1'};
+
+
+/// \brief Checkpoint and restart of the interface, the number of ranks may change in between.
+///
+/// The .ckpt file holds the grid, the owned box and GridData layout of every rank that wrote it,
+/// and the values of the whole grid in natural order (x fastest). Ranks write and read only
+/// their own box through the subarray file view, so the restart on any number of ranks reads
+/// every value exactly once and no rank touches more than its block.
+///
+///   CheckpointHeader
+///   CheckpointBlock x nRanks
+///   GridData        x nRanks
+///   values          at dataOffset
+class Checkpoint {
+
+	static MPI_Offset blocksOffset() {
+		return sizeof(CheckpointHeader);
+	}
+
+public:
+
+	template <typename type, int dim>
+	static void save(const Interface<type, dim>& data, const char* file);
+
+	/// read the header on rank 0 and broadcast it, returns false when the file is no checkpoint,
+	/// the grid for load() is made from bl, tr and dims of the header
+	static bool readHeader(const char* file, CheckpointHeader& header);
+
+	/// read the owned block of the interface and refresh its ghost layer,
+	/// the grid of the interface has to match the header, its decomposition does not,
+	/// a grid with other nodes, corners or spacing is reported and false returned
+	template <typename type, int dim>
+	static bool load(Interface<type, dim>& data, const char* file);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+template <typename type, int dim>
+void Checkpoint::save(const Interface<type, dim>& data, const char* file) {
+
+	int rank, nRanks;
+	const Grid<type, dim>& gr   = data.getGrid();
+	const DMDALocalInfo*   info = gr.getLocalInfo();
+
+	MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+	MPI_Comm_size(PETSC_COMM_WORLD, &nRanks);
+
+	CheckpointBlock me = {{info->xs, info->ys, info->zs}, {info->xm, info->ym, info->zm}};
+	std::vector<CheckpointBlock> blocks(rank == 0 ? nRanks : 0);
+	MPI_Gather(&me, sizeof(me), MPI_BYTE, blocks.data(), sizeof(me), MPI_BYTE, 0, PETSC_COMM_WORLD);
+
+	MPI_Offset layoutOffset = blocksOffset() + nRanks * sizeof(CheckpointBlock);
+	MPI_Offset dataOffset   = layoutOffset + nRanks * sizeof(GridData);
+	dataOffset = (dataOffset + 7) / 8 * 8;
+
+	std::vector<PetscReal> owned;
+	data.getOwnedData(owned);
+
+	MPI_File     fh;
+	MPI_Status   status;
+	MPI_Datatype filetype = gr.createOwnedSubarrayType();
+
+	MPI_File_open(PETSC_COMM_WORLD, const_cast<char*>(file), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+	MPI_File_set_size(fh, 0);
+
+	if (rank == 0) {
+		CheckpointHeader header;
+		memcpy(header.magic, checkpointMagic, sizeof(checkpointMagic));
+		header.dim    = dim;
+		header.nRanks = nRanks;
+		for (int d = 0; d < 3; ++d) {
+			header.dims[d] = gr.getM(d);
+			header.bl[d]   = gr.getMin(d);
+			header.tr[d]   = gr.getMax(d);
+		}
+		PetscInt procs[3];
+		DMDAGetInfo(gr.getDA(), PETSC_NULL, PETSC_NULL, PETSC_NULL, PETSC_NULL,
+		            &procs[0], &procs[1], &procs[2],
+		            PETSC_NULL, PETSC_NULL, PETSC_NULL, PETSC_NULL, PETSC_NULL, PETSC_NULL);
+		for (int d = 0; d < 3; ++d) {
+			header.procs[d] = procs[d];
+		}
+		header.dataOffset = dataOffset;
+
+		std::vector<GridData> layout(nRanks);
+		for (int p = 0; p < nRanks; ++p) {
+			layout[p] = gr.getLayout(p);
+		}
+
+		MPI_File_write_at(fh, 0, &header, sizeof(header), MPI_BYTE, &status);
+		MPI_File_write_at(fh, blocksOffset(), blocks.data(), nRanks * sizeof(CheckpointBlock), MPI_BYTE, &status);
+		MPI_File_write_at(fh, layoutOffset, layout.data(), nRanks * sizeof(GridData), MPI_BYTE, &status);
+	}
+
+	MPI_File_set_view(fh, dataOffset, MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
+	MPI_File_write_at_all(fh, 0, owned.data(), owned.size(), MPI_DOUBLE, &status);
+
+	MPI_File_close(&fh);
+	MPI_Type_free(&filetype);
+
+}
+
+inline bool Checkpoint::readHeader(const char* file, CheckpointHeader& header) {
+
+	int rank, ok = 0;
+
+	MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+
+	if (rank == 0) {
+		FILE* fp = fopen(file, "rb");
+		if ( fp != NULL ) {
+			ok = fread(&header, sizeof(header), 1, fp) == 1 && memcmp(header.magic, checkpointMagic, sizeof(checkpointMagic)) == 0;
+			fclose(fp);
+		}
+	}
+
+	MPI_Bcast(&ok, 1, MPI_INT, 0, PETSC_COMM_WORLD);
+	if ( !ok )
+		return false;
+
+	MPI_Bcast(&header, sizeof(header), MPI_BYTE, 0, PETSC_COMM_WORLD);
+
+	return true;
+
+}
+
+template <typename type, int dim>
+bool Checkpoint::load(Interface<type, dim>& data, const char* file) {
+
+	const Grid<type, dim>& gr = data.getGrid();
+	DM                     da = gr.getDA();
+	CheckpointHeader       header;
+
+	if ( !readHeader(file, header) )
+		return false;
+
+	// the spacing follows from the corners and the nodes, a rounding off is allowed in all of them
+	for (int d = 0; d < 3; ++d) {
+		const double dx  = (header.dims[d] > 1) ? (header.tr[d] - header.bl[d]) / (header.dims[d] - 1) : 0;
+		const double eps = 1e-6 * gr.getDx(d);
+
+		if ( header.dims[d] != gr.getM(d) ) {
+			PetscPrintf(PETSC_COMM_WORLD, "%s: %d nodes along axis %d, the grid has %d\n", file, header.dims[d], d, int(gr.getM(d)));
+			return false;
+		}
+		if ( std::abs(header.bl[d] - gr.getMin(d)) > eps || std::abs(header.tr[d] - gr.getMax(d)) > eps ) {
+			PetscPrintf(PETSC_COMM_WORLD, "%s: axis %d spans [%g, %g], the grid [%g, %g]\n", file, d,
+			            header.bl[d], header.tr[d], gr.getMin(d), gr.getMax(d));
+			return false;
+		}
+		if ( header.dims[d] > 1 && std::abs(dx - gr.getDx(d)) > 1e-6 * dx ) {
+			PetscPrintf(PETSC_COMM_WORLD, "%s: spacing %g along axis %d, the grid has %g\n", file, dx, d, gr.getDx(d));
+			return false;
+		}
+	}
+
+	std::vector<PetscReal> owned( gr.getNumberOfOwnedCells() );
+
+	MPI_File     fh;
+	MPI_Status   status;
+	MPI_Datatype filetype = gr.createOwnedSubarrayType();
+
+	MPI_File_open(PETSC_COMM_WORLD, const_cast<char*>(file), MPI_MODE_RDONLY, MPI_INFO_NULL, &fh);
+	MPI_File_set_view(fh, header.dataOffset, MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
+	MPI_File_read_at_all(fh, 0, owned.data(), owned.size(), MPI_DOUBLE, &status);
+	MPI_File_close(&fh);
+	MPI_Type_free(&filetype);
+
+	data.setOwnedData(owned);
+
+	// ghost layer comes from the new neighbors
+	Vec glob;
+	DMGetGlobalVector(da, &glob);
+	DMLocalToGlobalBegin(da, data.getLocalData(), INSERT_VALUES, glob);
+	DMLocalToGlobalEnd(da, data.getLocalData(), INSERT_VALUES, glob);
+	DMGlobalToLocalBegin(da, glob, INSERT_VALUES, data.getLocalData());
+	DMGlobalToLocalEnd(da, glob, INSERT_VALUES, data.getLocalData());
+	DMRestoreGlobalVector(da, &glob);
+
+	return true;
+
+}
+
+#endif /* CHECKPOINT_HPP_ */
@@ -0,0 +1,162 @@
+/*
+ * ClosestPointField.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef CLOSESTPOINTFIELD_HPP_
+#define CLOSESTPOINTFIELD_HPP_
+
+#include <vector>
+#include <unordered_map>
+#include <petscdmda.h>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+
+#include "FastMarching.hpp"
+
+
+/// \brief Closest triangle ID and closest surface point of the narrow band cells.
+///
+/// Filled by the Initializer next to the signed distance. Only the band cells are stored,
+/// so the memory grows with the surface, not with the grid. Dense fields for the whole
+/// grid are made on demand by toFields() and carried to the far field by the fast marching
+/// solver as extension fields (see getExtensions()).
+///
+/// Cells are identified by their index into the local ghosted block, x fastest.
+class ClosestPointField {
+
+	typedef std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > pointList_type;
+
+	std::vector<long int>            cells;
+	std::vector<long int>            triangleIDs;
+	pointList_type                   points;
+
+	/// position of the cell in the lists above
+	std::unordered_map<long int, int> slots;
+
+public:
+
+	ClosestPointField() {};
+
+	/// store the closest triangle of the cell, previous value of the cell is overwritten
+	void set(long int cell, long int triangleID, const Eigen::Vector3d& point);
+
+	/// closest triangle of the cell, false when the cell is not in the band
+	bool get(long int cell, long int& triangleID, Eigen::Vector3d& point) const;
+
+	size_t size() const {
+		return cells.size();
+	}
+
+	long int getCell(size_t i) const {
+		return cells[i];
+	}
+
+	long int getTriangleID(size_t i) const {
+		return triangleIDs[i];
+	}
+
+	const Eigen::Vector3d& getPoint(size_t i) const {
+		return points[i];
+	}
+
+	void clear();
+
+	/// scatter the band into dense local ghosted vectors of the grid DMDA the cells were taken from,
+	/// cells outside of the band get ID -1 and point 0
+	void toFields(Vec id, Vec point[3]) const;
+
+	/// dense fields as extension fields of the fast marching, closest point and ID are both
+	/// copied from the upwind neighbor so they stay consistent with each other
+	static std::vector<ExtensionField> getExtensions(Vec id, Vec point[3]);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+inline void ClosestPointField::set(long int cell, long int triangleID, const Eigen::Vector3d& point) {
+
+	std::unordered_map<long int, int>::iterator it = slots.find(cell);
+
+	if ( it == slots.end() ) {
+		slots[cell] = cells.size();
+		cells.push_back(cell);
+		triangleIDs.push_back(triangleID);
+		points.push_back(point);
+	} else {
+		triangleIDs[it->second] = triangleID;
+		points[it->second]      = point;
+	}
+
+}
+
+inline bool ClosestPointField::get(long int cell, long int& triangleID, Eigen::Vector3d& point) const {
+
+	std::unordered_map<long int, int>::const_iterator it = slots.find(cell);
+
+	if ( it == slots.end() )
+		return false;
+
+	triangleID = triangleIDs[it->second];
+	point      = points[it->second];
+
+	return true;
+
+}
+
+inline void ClosestPointField::clear() {
+
+	cells.clear();
+	triangleIDs.clear();
+	points.clear();
+	slots.clear();
+
+}
+
+inline void ClosestPointField::toFields(Vec id, Vec point[3]) const {
+
+	PetscReal* idArr;
+	PetscReal* pArr[3];
+
+	VecSet(id, -1.0);
+	VecGetArray(id, &idArr);
+
+	for (int d = 0; d < 3; ++d) {
+		VecSet(point[d], 0.0);
+		VecGetArray(point[d], &pArr[d]);
+	}
+
+	for (size_t i = 0; i < cells.size(); ++i) {
+		idArr[cells[i]] = triangleIDs[i];
+		for (int d = 0; d < 3; ++d) {
+			pArr[d][cells[i]] = points[i][d];
+		}
+	}
+
+	for (int d = 0; d < 3; ++d) {
+		VecRestoreArray(point[d], &pArr[d]);
+	}
+	VecRestoreArray(id, &idArr);
+
+}
+
+inline std::vector<ExtensionField> ClosestPointField::getExtensions(Vec id, Vec point[3]) {
+
+	std::vector<ExtensionField> extensions;
+
+	extensions.push_back( ExtensionField(id, EXTEND_NEAREST) );
+	for (int d = 0; d < 3; ++d) {
+		extensions.push_back( ExtensionField(point[d], EXTEND_NEAREST) );
+	}
+
+	return extensions;
+
+}
+
+#endif /* CLOSESTPOINTFIELD_HPP_ */
@@ -0,0 +1,164 @@
+/*
+ * Decomposition.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef DECOMPOSITION_HPP_
+#define DECOMPOSITION_HPP_
+
+#include <petscsys.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "Geometry.hpp"
+
+
+/// \brief Geometry aware ownership ranges for the DMDA
+///
+/// Initialization cost of a block is dominated by the triangles, every triangle computes the
+/// distance in all nodes of its padded AABB (see Initializer::putLocalDataInside). The cost is
+/// estimated along each axis from a histogram of the triangle AABBs, plus a small cost of every node
+/// for the fill and the boundary work. Each axis is then cut into slabs of the same cost.
+///
+/// DMDA splits the grid as a tensor product, so the cost is treated as separable, the triangle
+/// work of the node plane is the sum over the triangles crossing it. Geometry is the same on every
+/// rank, so every rank computes the same ranges without communication.
+class Decomposition {
+
+	/// cost of a node relative to a single triangle distance evaluation
+	static double nodeCost() { return 0.05; }
+
+	/// node index of the coordinate clamped to the grid, padded as in Grid::getGlobalBoxIndices
+	static PetscInt toIndex(double x, double minX, double dx, PetscInt M, PetscInt padding, bool upper) {
+		double   s = (x - minX) / dx;
+		PetscInt i = upper ? PetscInt(std::ceil(s)) + padding : PetscInt(std::floor(s)) - padding;
+		return std::max(PetscInt(0), std::min(i, M - 1));
+	}
+
+	/// cuts the cost into parts of the same sum, every part keeps at least one node
+	static void split(const std::vector<double>& cost, PetscInt parts, std::vector<PetscInt>& ranges);
+
+public:
+
+	/// Computes the process layout and the ownership ranges of the grid
+	///
+	/// \param geom geometry to be initialized on the grid
+	/// \param minX lower point of the grid
+	/// \param maxX upper point of the grid
+	/// \param M    number of nodes in each direction
+	/// \param NP   number of processes in each direction, PETSC_DECIDE ones are filled in
+	/// \param ranges number of nodes owned along each direction, lx, ly, lz of DMDACreate3d
+	static void balance(const Geometry& geom, const PetscReal* minX, const PetscReal* maxX, const PetscInt* M,
+	                    PetscInt* NP, std::vector<PetscInt> ranges[3]);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+inline void Decomposition::split(const std::vector<double>& cost, PetscInt parts, std::vector<PetscInt>& ranges) {
+
+	const PetscInt M = cost.size();
+
+	std::vector<double> prefix(M + 1, 0);
+	for (PetscInt i = 0; i < M; ++i) {
+		prefix[i + 1] = prefix[i] + cost[i];
+	}
+
+	ranges.assign(parts, 0);
+
+	PetscInt start = 0;
+	for (PetscInt p = 0; p < parts - 1; ++p) {
+		double target = prefix[M] * (p + 1) / parts;
+
+		// first end where the part reaches its share, leave one node to each of the remaining parts
+		PetscInt end = std::lower_bound(prefix.begin() + start + 1, prefix.end(), target) - prefix.begin();
+		end = std::max(end, start + 1);
+		end = std::min(end, M - (parts - 1 - p));
+
+		ranges[p] = end - start;
+		start     = end;
+	}
+	ranges[parts - 1] = M - start;
+
+}
+
+
+inline void Decomposition::balance(const Geometry& geom, const PetscReal* minX, const PetscReal* maxX, const PetscInt* M,
+                                   PetscInt* NP, std::vector<PetscInt> ranges[3]) {
+
+	int size;
+	MPI_Comm_size(PETSC_COMM_WORLD, &size);
+
+	// free directions get the MPI choice, the largest count on the longest grid direction
+	int dims[3] = {0, 0, 0};
+	for (int d = 0; d < 3; ++d) {
+		dims[d] = (NP[d] == PETSC_DECIDE) ? 0 : NP[d];
+	}
+	MPI_Dims_create(size, 3, dims);
+
+	std::vector<int> freeDims, freeCounts;
+	for (int d = 0; d < 3; ++d) {
+		if (NP[d] == PETSC_DECIDE) {
+			freeDims.push_back(d);
+			freeCounts.push_back(dims[d]);
+		}
+	}
+	std::sort(freeCounts.begin(), freeCounts.end());
+	std::sort(freeDims.begin(), freeDims.end(), [M](int a, int b) { return M[a] < M[b]; });
+	for (size_t f = 0; f < freeDims.size(); ++f) {
+		NP[freeDims[f]] = freeCounts[f];
+	}
+
+	double dx[3];
+	for (int d = 0; d < 3; ++d) {
+		dx[d] = (maxX[d] - minX[d]) / (M[d] - 1);
+	}
+
+	// difference arrays, triangle adds the size of its box cross section to every plane it crosses
+	std::vector<double> diff[3];
+	for (int d = 0; d < 3; ++d) {
+		diff[d].assign(M[d] + 1, 0);
+	}
+
+	const PetscInt padding = 2;
+
+	TriangleElement<double> element;
+
+	for (long int e = 0; e < geom.getNumberOfElements(); ++e) {
+		const auto bb = geom.getElement(e, element).getBoundingBox();
+
+		PetscInt lo[3], n[3];
+		for (int d = 0; d < 3; ++d) {
+			lo[d] = toIndex(bb.minX(d), minX[d], dx[d], M[d], padding, false);
+			n[d]  = toIndex(bb.maxX(d), minX[d], dx[d], M[d], padding, true) - lo[d] + 1;
+		}
+
+		for (int d = 0; d < 3; ++d) {
+			double section = double(n[(d + 1) % 3]) * n[(d + 2) % 3];
+			diff[d][lo[d]]        += section;
+			diff[d][lo[d] + n[d]] -= section;
+		}
+	}
+
+	for (int d = 0; d < 3; ++d) {
+		const double plane = nodeCost() * double(M[(d + 1) % 3]) * M[(d + 2) % 3];
+
+		std::vector<double> cost(M[d]);
+		double              running = 0;
+		for (PetscInt i = 0; i < M[d]; ++i) {
+			running += diff[d][i];
+			cost[i]  = running + plane;
+		}
+
+		split(cost, NP[d], ranges[d]);
+	}
+
+}
+
+#endif /* DECOMPOSITION_HPP_ */
@@ -0,0 +1,561 @@
+/*
+ * FastMarching.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef FASTMARCHING_HPP_
+#define FASTMARCHING_HPP_
+
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <petscdmda.h>
+
+#include "Grid.hpp"
+#include "FmmHeap.hpp"
+
+
+/// how the value of an extension field is carried from the upwind neighbors
+enum ExtensionMode {
+	EXTEND_AVERAGE = 0, ///< weighted by the upwind differences, gives grad f . grad phi = 0 (velocities)
+	EXTEND_NEAREST = 1  ///< copied from the closest upwind neighbor, for labels like triangle ID
+};
+
+/// scalar field extended off the interface in the same march as phi
+struct ExtensionField {
+	Vec           field; ///< local ghosted vector of the same DMDA as phi, band values are the input
+	ExtensionMode mode;
+
+	ExtensionField(Vec _field, ExtensionMode _mode = EXTEND_AVERAGE) : field(_field), mode(_mode) {};
+};
+
+/// \brief Native first order fast marching solver of the eikonal equation |grad phi| = 1.
+///
+/// Works in place on the local ghosted block of the interface. Cells with |phi| < farValue
+/// are taken as fixed (narrow band computed by initializer), the rest is computed by marching.
+/// The sign of a computed cell is taken from its upwind neighbor, so no shifting of the exterior
+/// values is needed as in FmmWrapper.
+///
+/// Computed cells can be reopened when a smaller value arrives from outside of the block. This is
+/// used by the parallel solver, which exchanges the ghost layer between the rounds of marching
+/// until no rank improves any value (domain decomposed FMM with rollback, Yang & Stern).
+///
+/// Optionally any number of extra scalar fields is extended along the characteristics in the same
+/// march. Value of the field is set whenever the tentative value of the cell is, from the same
+/// upwind neighbors, so no second sorted pass over the grid is needed.
+///
+/// \tparam precision type used to compare the keys in the heap (float or double)
+template <typename precision = double>
+class FastMarching {
+
+	enum CellState {FAR = 0, TRIAL = 1, KNOWN = 2, FIXED = 3};
+
+	int    dims[3];    ///< size of the ghosted block
+	long   strides[3]; ///< linear index stride along each dimension
+	double dx[3];      ///< grid spacing
+	double tolerance;  ///< smallest improvement that reopens a computed cell
+
+	std::vector<char>  state;
+	FmmHeap<precision> heap;
+
+	std::vector<double*>       ext;      ///< extension fields, same layout as phi
+	std::vector<ExtensionMode> extModes;
+
+	/// compute tentative value of the cell from its known neighbors, sign is returned via argument,
+	/// the upwind neighbors used and their weights are returned in nb and w when given
+	double tentative(const double* phi, long cell, int& sign, long* nb = NULL, double* w = NULL, int* used = NULL) const;
+
+	/// set the extension fields of the cell from its upwind neighbors
+	void extend(long cell, const long* nb, const double* w, int used);
+
+	static void getExtensionArrays(const std::vector<ExtensionField>& extensions, std::vector<double*>& arrays, std::vector<ExtensionMode>& modes);
+	static void restoreExtensionArrays(const std::vector<ExtensionField>& extensions, std::vector<double*>& arrays);
+
+	/// recompute tentative values of the neighbors of the cell, fixed cells are never touched
+	void updateNeighbors(double* phi, long cell);
+
+public:
+
+	/// values larger than this are considered as not yet computed
+	static const double farValue;
+
+	/// Solves the upwind quadratic from the smallest known neighbor along each axis, shared
+	/// with SparseFastMarching. a are the absolute values of the neighbors, h their spacing,
+	/// sgn their signs and src their cells, count of them. The arrays are sorted in place.
+	static double upwind(double a[3], double h[3], int sgn[3], long src[3], int count,
+	                     int& sign, long* nb = NULL, double* w = NULL, int* used = NULL);
+
+	/// \param _dims number of the cells in each dimension of the block
+	/// \param _dx   grid spacing in each dimension
+	FastMarching(const int _dims[3], const double _dx[3]);
+
+	/// attach the arrays of the extension fields, they have to stay valid during the march
+	void setExtensions(const std::vector<double*>& arrays, const std::vector<ExtensionMode>& modes);
+
+	/// mark the band as fixed and build the initial front around it
+	void initialize(double* phi);
+
+	/// march until the front is empty
+	void propagate(double* phi);
+
+	/// march the whole block, phi is the block data stored x fastest
+	void march(double* phi);
+
+	/// offer a new value of the cell coming from outside of the block,
+	/// the cell is queued again when the value improves it
+	bool reopen(double* phi, long cell, double value);
+
+	/// solve local part of the eikonal equation, the same way FmmWrapper does it
+	template <int dim>
+	static bool solveEikonalEquation(const Grid<double, dim>& gr, Vec phi,
+	                                 const std::vector<ExtensionField>& extensions = std::vector<ExtensionField>());
+
+	/// solve the eikonal equation on the whole grid, ranks exchange their ghost layers
+	/// and march again until nothing changes, returns number of exchange rounds
+	template <int dim>
+	static int solveEikonalEquationParallel(const Grid<double, dim>& gr, Vec phi,
+	                                        const std::vector<ExtensionField>& extensions = std::vector<ExtensionField>());
+
+};
+
+template <typename precision>
+const double FastMarching<precision>::farValue = 1E+15;
+
+
+///===================================
+///          Implementation
+///===================================
+
+template <typename precision>
+FastMarching<precision>::FastMarching(const int _dims[3], const double _dx[3]) :
+		state( long(_dims[0]) * _dims[1] * _dims[2], FAR ),
+		heap(  long(_dims[0]) * _dims[1] * _dims[2] ) {
+
+	for (int i = 0; i < 3; ++i) {
+		dims[i] = _dims[i];
+		dx[i]   = _dx[i];
+	}
+
+	tolerance = 1E-10 * std::min(dx[0], std::min(dx[1], dx[2]));
+
+	strides[0] = 1;
+	strides[1] = dims[0];
+	strides[2] = long(dims[0]) * dims[1];
+
+}
+
+template <typename precision>
+void FastMarching<precision>::setExtensions(const std::vector<double*>& arrays, const std::vector<ExtensionMode>& modes) {
+
+	ext      = arrays;
+	extModes = modes;
+
+}
+
+template <typename precision>
+double FastMarching<precision>::tentative(const double* phi, long cell, int& sign, long* nb, double* w, int* used) const {
+
+	double a[3], h[3];
+	int    sgn[3];
+	long   src[3];
+	int    count = 0;
+
+	long rem = cell;
+	int  ind[3];
+	ind[2] = rem / strides[2]; rem -= ind[2] * strides[2];
+	ind[1] = rem / strides[1];
+	ind[0] = rem - ind[1] * strides[1];
+
+	// smallest known neighbor along each axis
+	for (int d = 0; d < 3; ++d) {
+		double best = std::numeric_limits<double>::max();
+		int    bs   = 0;
+		long   bc   = 0;
+
+		if ( ind[d] > 0 && state[cell - strides[d]] >= KNOWN ) {
+			double v = phi[cell - strides[d]];
+			best = std::abs(v);
+			bs   = (v < 0) ? -1 : 1;
+			bc   = cell - strides[d];
+		}
+		if ( ind[d] < dims[d] - 1 && state[cell + strides[d]] >= KNOWN ) {
+			double v = phi[cell + strides[d]];
+			if ( std::abs(v) < best ) {
+				best = std::abs(v);
+				bs   = (v < 0) ? -1 : 1;
+				bc   = cell + strides[d];
+			}
+		}
+
+		if ( bs != 0 ) {
+			a[count]   = best;
+			h[count]   = dx[d];
+			sgn[count] = bs;
+			src[count] = bc;
+			count++;
+		}
+	}
+
+	return upwind(a, h, sgn, src, count, sign, nb, w, used);
+
+}
+
+template <typename precision>
+double FastMarching<precision>::upwind(double a[3], double h[3], int sgn[3], long src[3], int count,
+                                       int& sign, long* nb, double* w, int* used) {
+
+	// sort the neighbors ascending, there are at most three of them
+	for (int i = 1; i < count; ++i) {
+		for (int j = i; j > 0 && a[j] < a[j-1]; --j) {
+			std::swap(a[j], a[j-1]);
+			std::swap(h[j], h[j-1]);
+			std::swap(sgn[j], sgn[j-1]);
+			std::swap(src[j], src[j-1]);
+		}
+	}
+
+	sign = sgn[0];
+
+	// solve sum((u - a_i)/h_i)^2 = 1 adding the neighbors while they stay upwind
+	double u = a[0] + h[0];
+	double A = 0, B = 0, C = -1;
+	int    n = 0;
+	for (int i = 0; i < count; ++i) {
+		if ( u <= a[i] )
+			break;
+
+		double ih2 = 1.0 / (h[i]*h[i]);
+		A += ih2;
+		B -= 2.0 * a[i] * ih2;
+		C += a[i] * a[i] * ih2;
+
+		double disc = B*B - 4.0*A*C;
+		if ( disc < 0 )
+			break;
+
+		u = (-B + std::sqrt(disc)) / (2.0*A);
+		n = i + 1;
+	}
+
+	if ( nb != NULL ) {
+		// discrete grad f . grad phi = 0 weights each upwind neighbor by (u - a_i)/h_i^2
+		for (int i = 0; i < n; ++i) {
+			nb[i] = src[i];
+			w[i]  = (u - a[i]) / (h[i]*h[i]);
+		}
+		*used = n;
+	}
+
+	return u;
+
+}
+
+template <typename precision>
+void FastMarching<precision>::updateNeighbors(double* phi, long cell) {
+
+	long rem = cell;
+	int  ind[3];
+	ind[2] = rem / strides[2]; rem -= ind[2] * strides[2];
+	ind[1] = rem / strides[1];
+	ind[0] = rem - ind[1] * strides[1];
+
+	for (int d = 0; d < 3; ++d) {
+		for (int dir = -1; dir <= 1; dir += 2) {
+			int ni = ind[d] + dir;
+			if ( ni < 0 || ni >= dims[d] )
+				continue;
+
+			long neighbor = cell + dir * strides[d];
+			if ( state[neighbor] == FIXED )
+				continue;
+
+			int    sign, used;
+			long   nb[3];
+			double w[3];
+			double u = tentative(phi, neighbor, sign, nb, w, &used);
+
+			// known cells are rolled back only when the improvement is real, not a round off
+			if ( u < std::abs(phi[neighbor]) - tolerance ) {
+				phi[neighbor]   = sign * u;
+				state[neighbor] = TRIAL;
+				heap.push(neighbor, precision(u));
+
+				if ( !ext.empty() )
+					extend(neighbor, nb, w, used);
+			}
+		}
+	}
+
+}
+
+template <typename precision>
+void FastMarching<precision>::extend(long cell, const long* nb, const double* w, int used) {
+
+	double sum = 0;
+	for (int i = 0; i < used; ++i) {
+		sum += w[i];
+	}
+
+	for (size_t e = 0; e < ext.size(); ++e) {
+		double* f = ext[e];
+
+		// neighbors sorted ascending, the first one is the closest to the interface
+		if ( extModes[e] == EXTEND_NEAREST || sum <= 0 ) {
+			f[cell] = f[nb[0]];
+			continue;
+		}
+
+		double value = 0;
+		for (int i = 0; i < used; ++i) {
+			value += w[i] * f[nb[i]];
+		}
+		f[cell] = value / sum;
+	}
+
+}
+
+template <typename precision>
+void FastMarching<precision>::initialize(double* phi) {
+
+	long numberOfCells = state.size();
+
+	heap.clear();
+
+	for (long c = 0; c < numberOfCells; ++c) {
+		state[c] = ( std::abs(phi[c]) < farValue ) ? FIXED : FAR;
+	}
+
+	// the initial front are neighbors of the fixed band
+	for (long c = 0; c < numberOfCells; ++c) {
+		if ( state[c] == FIXED )
+			updateNeighbors(phi, c);
+	}
+
+}
+
+template <typename precision>
+void FastMarching<precision>::propagate(double* phi) {
+
+	while ( !heap.empty() ) {
+		long cell   = heap.pop();
+		state[cell] = KNOWN;
+		updateNeighbors(phi, cell);
+	}
+
+}
+
+template <typename precision>
+void FastMarching<precision>::march(double* phi) {
+
+	initialize(phi);
+	propagate(phi);
+
+}
+
+template <typename precision>
+bool FastMarching<precision>::reopen(double* phi, long cell, double value) {
+
+	if ( state[cell] == FIXED )
+		return false;
+
+	if ( !(std::abs(value) < std::abs(phi[cell]) - tolerance) )
+		return false;
+
+	phi[cell]   = value;
+	state[cell] = TRIAL;
+	heap.push(cell, precision(std::abs(value)));
+
+	return true;
+
+}
+
+template <typename precision>
+void FastMarching<precision>::getExtensionArrays(const std::vector<ExtensionField>& extensions,
+                                                 std::vector<double*>& arrays, std::vector<ExtensionMode>& modes) {
+
+	arrays.resize(extensions.size());
+	modes.resize(extensions.size());
+
+	for (size_t e = 0; e < extensions.size(); ++e) {
+		VecGetArray(extensions[e].field, &arrays[e]);
+		modes[e] = extensions[e].mode;
+	}
+
+}
+
+template <typename precision>
+void FastMarching<precision>::restoreExtensionArrays(const std::vector<ExtensionField>& extensions, std::vector<double*>& arrays) {
+
+	for (size_t e = 0; e < extensions.size(); ++e) {
+		VecRestoreArray(extensions[e].field, &arrays[e]);
+	}
+
+}
+
+template <typename precision> template <int dim>
+bool FastMarching<precision>::solveEikonalEquation(const Grid<double, dim>& gr, Vec phi,
+                                                   const std::vector<ExtensionField>& extensions) {
+	// solves the local ghosted part only, ranks do not talk to each other
+
+	int        grid_dims[3] = {1, 1, 1};
+	double     h[3]         = {1, 1, 1};
+	PetscReal* arr;
+
+	for (int i = 0; i < dim; ++i) {
+		grid_dims[i] = gr.getLocalM(i);
+		h[i]         = gr.getDx(i);
+	}
+
+	std::vector<double*>       extArr;
+	std::vector<ExtensionMode> modes;
+
+	VecGetArray(phi, &arr);
+	getExtensionArrays(extensions, extArr, modes);
+
+	FastMarching<precision> fmm(grid_dims, h);
+	fmm.setExtensions(extArr, modes);
+	fmm.march(arr);
+
+	restoreExtensionArrays(extensions, extArr);
+	VecRestoreArray(phi, &arr);
+
+	return true;
+
+}
+
+template <typename precision> template <int dim>
+int FastMarching<precision>::solveEikonalEquationParallel(const Grid<double, dim>& gr, Vec phi,
+                                                          const std::vector<ExtensionField>& extensions) {
+
+	const DMDALocalInfo* info = gr.getLocalInfo();
+	DM                   da   = gr.getDA();
+
+	int        grid_dims[3] = {1, 1, 1};
+	double     h[3]         = {1, 1, 1};
+	PetscReal* arr;
+	PetscReal* received;
+	Vec        glob, ghosts;
+	int        rounds = 0;
+
+	std::vector<double*>       extArr;
+	std::vector<ExtensionMode> modes;
+	std::vector<long>          reopened;
+
+	for (int i = 0; i < dim; ++i) {
+		grid_dims[i] = gr.getLocalM(i);
+		h[i]         = gr.getDx(i);
+	}
+
+	// owned part of the block in local ghosted indices, everything around is ghost layer
+	int lo[3] = {info->xs - info->gxs, info->ys - info->gys, info->zs - info->gzs};
+	int hi[3] = {lo[0] + info->xm,     lo[1] + info->ym,     lo[2] + info->zm};
+
+	// ghosts out of the domain are never filled by the scatter, only the ones inside are compared
+	int first[3] = {std::max(0, -int(info->gxs)), std::max(0, -int(info->gys)), std::max(0, -int(info->gzs))};
+	int last[3]  = {std::min(grid_dims[0], int(info->mx - info->gxs)),
+	                std::min(grid_dims[1], int(info->my - info->gys)),
+	                std::min(grid_dims[2], int(info->mz - info->gzs))};
+
+	FastMarching<precision> fmm(grid_dims, h);
+
+	VecGetArray(phi, &arr);
+	getExtensionArrays(extensions, extArr, modes);
+	fmm.setExtensions(extArr, modes);
+	fmm.march(arr);
+	restoreExtensionArrays(extensions, extArr);
+	VecRestoreArray(phi, &arr);
+
+	DMGetGlobalVector(da, &glob);
+	DMGetLocalVector(da, &ghosts);
+
+	while ( true ) {
+
+		// owners publish their values, the ghost layer receives them
+		DMLocalToGlobalBegin(da, phi, INSERT_VALUES, glob);
+		DMLocalToGlobalEnd(da, phi, INSERT_VALUES, glob);
+		DMGlobalToLocalBegin(da, glob, INSERT_VALUES, ghosts);
+		DMGlobalToLocalEnd(da, glob, INSERT_VALUES, ghosts);
+
+		VecGetArray(phi, &arr);
+		VecGetArray(ghosts, &received);
+
+		reopened.clear();
+		for (int k = first[2]; k < last[2]; ++k) {
+			for (int j = first[1]; j < last[1]; ++j) {
+				bool ghostRow = k < lo[2] || k >= hi[2] || j < lo[1] || j >= hi[1];
+				for (int i = first[0]; i < last[0]; ++i) {
+					if ( !ghostRow && i == lo[0] ) {
+						i = hi[0] - 1; // skip the owned part of the row
+						continue;
+					}
+					long c = i + j*long(grid_dims[0]) + k*long(grid_dims[0])*grid_dims[1];
+					if ( fmm.reopen(arr, c, received[c]) )
+						reopened.push_back(c);
+				}
+			}
+		}
+
+		VecRestoreArray(ghosts, &received);
+		VecRestoreArray(phi, &arr);
+
+		int changed = reopened.empty() ? 0 : 1, anyChanged = 0;
+		MPI_Allreduce(&changed, &anyChanged, 1, MPI_INT, MPI_LOR, PETSC_COMM_WORLD);
+
+		if ( anyChanged ) {
+			// reopened ghost cells take the extension values of their owners too
+			for (size_t e = 0; e < extensions.size(); ++e) {
+				Vec field = extensions[e].field;
+
+				DMLocalToGlobalBegin(da, field, INSERT_VALUES, glob);
+				DMLocalToGlobalEnd(da, field, INSERT_VALUES, glob);
+				DMGlobalToLocalBegin(da, glob, INSERT_VALUES, ghosts);
+				DMGlobalToLocalEnd(da, glob, INSERT_VALUES, ghosts);
+
+				PetscReal* f;
+				VecGetArray(field, &f);
+				VecGetArray(ghosts, &received);
+				for (size_t r = 0; r < reopened.size(); ++r) {
+					f[reopened[r]] = received[reopened[r]];
+				}
+				VecRestoreArray(ghosts, &received);
+				VecRestoreArray(field, &f);
+			}
+
+			VecGetArray(phi, &arr);
+			getExtensionArrays(extensions, extArr, modes);
+			fmm.setExtensions(extArr, modes);
+			fmm.propagate(arr);
+			restoreExtensionArrays(extensions, extArr);
+			VecRestoreArray(phi, &arr);
+		}
+
+		if ( !anyChanged )
+			break;
+
+		rounds++;
+	}
+
+	// leave the ghost layers consistent with the owners, glob may hold an extension field by now
+	DMLocalToGlobalBegin(da, phi, INSERT_VALUES, glob);
+	DMLocalToGlobalEnd(da, phi, INSERT_VALUES, glob);
+	DMGlobalToLocalBegin(da, glob, INSERT_VALUES, phi);
+	DMGlobalToLocalEnd(da, glob, INSERT_VALUES, phi);
+
+	for (size_t e = 0; e < extensions.size(); ++e) {
+		DMLocalToGlobalBegin(da, extensions[e].field, INSERT_VALUES, glob);
+		DMLocalToGlobalEnd(da, extensions[e].field, INSERT_VALUES, glob);
+		DMGlobalToLocalBegin(da, glob, INSERT_VALUES, extensions[e].field);
+		DMGlobalToLocalEnd(da, glob, INSERT_VALUES, extensions[e].field);
+	}
+
+	DMRestoreLocalVector(da, &ghosts);
+	DMRestoreGlobalVector(da, &glob);
+
+	return rounds;
+
+}
+
+#endif /* FASTMARCHING_HPP_ */
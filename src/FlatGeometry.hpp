@@ -0,0 +1,396 @@
+/*
+ * FlatGeometry.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef FLATGEOMETRY_HPP_
+#define FLATGEOMETRY_HPP_
+
+#include <stdint.h>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <Eigen/Dense>
+#include "TriangleElement.hpp"
+#include "BoundingBox.hpp"
+#include "utility.h"
+
+
+/// \brief Pointer free geometry with its search tree in one contiguous segment
+///
+/// The segment holds a header, the triangles in their original order, the nodes of a bounding volume
+/// hierarchy and the permutation of the triangles used by the leaves. Nodes refer to each other and to
+/// the triangles by indices only, so the segment is valid at any address: in an MPI shared memory
+/// window mapped by all ranks of the node, or in a file.
+///
+/// The view does not own the segment, it only reads it.
+class FlatGeometry {
+
+public:
+
+	struct Header {
+		uint64_t magic;
+		int64_t  numberOfElements;
+		int64_t  numberOfNodes;
+		double   minX[3], maxX[3];  ///< global aabb, grown as the loaded geometry
+	};
+
+	struct Triangle {
+		double  vertices[3][3];
+		double  normal[3];
+		int64_t ID;
+	};
+
+	/// leaf holds count triangles of the order array starting at first, inner node has count == 0
+	struct Node {
+		double  minX[3], maxX[3];
+		int32_t first, count;
+		int32_t left, right;
+	};
+
+	static const uint64_t magicNumber = 0x4C53464C41543031ull; // "LSFLAT01"
+
+private:
+
+	static const int leafSize = 4;
+
+	const Header*   header;
+	const Triangle* triangles;
+	const Node*     nodes;
+	const int32_t*  order;
+
+	/// splits the triangles [first, last) of order at the median centroid of the longest direction
+	static int32_t buildNode(const std::vector<Triangle>& tris, std::vector<double>& centroids,
+	                         std::vector<int32_t>& order, int32_t first, int32_t last, std::vector<Node>& nodes);
+
+	/// squared distance of the point from the node box
+	static double boxDistance(const Node& node, const Eigen::Vector3d& point);
+
+	void fill(long int index, TriangleElement<double>& element) const;
+
+public:
+
+	FlatGeometry() : header(NULL), triangles(NULL), nodes(NULL), order(NULL) {}
+
+	/// view of the segment written by write
+	explicit FlatGeometry(const char* segment);
+
+	bool empty() const {
+		return header == NULL;
+	}
+
+	long int getNumberOfElements() const {
+		return header->numberOfElements;
+	}
+
+	Box<double, 3> getAABB() const {
+		return Box<double, 3>(header->minX, header->maxX);
+	}
+
+	/// copy of the triangle into element, with the index of the original geometry,
+	/// the vertices of element are reused
+	void getElement(long int index, TriangleElement<double>& element) const;
+
+	/// Builds the search tree of the triangles, stored by write
+	///
+	/// \param elements triangles of the geometry
+	/// \param nodes    nodes of the tree, the first one is the root
+	/// \param order    triangles of the leaves
+	static void buildTree(const std::vector< TriangleElement<double> >& elements, std::vector<Node>& nodes, std::vector<int32_t>& order);
+
+	/// size of the segment in bytes
+	static size_t bytes(long int numberOfElements, long int numberOfNodes);
+
+	/// writes the segment, bytes(elements.size(), nodes.size()) long
+	static void write(const std::vector< TriangleElement<double> >& elements, const Box<double, 3>& aabb,
+	                  const std::vector<Node>& nodes, const std::vector<int32_t>& order, char* segment);
+
+	/// Signed distance to the closest triangle with index in [first, last), exact search of the tree.
+	/// Ties within my_eps go to the triangle with larger perpendicular distance, then to the later one, as in Geometry.
+	double computeDistance(const Eigen::Vector3d& point, long int first, long int last,
+	                       long int& closestID, Eigen::Vector3d& closestPoint, double& perpDistance) const;
+
+	/// indices of the triangles in [first, last) whose aabb touches the box
+	void overlapping(const Box<double, 3>& box, long int first, long int last, std::vector<long int>& found) const;
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+inline FlatGeometry::FlatGeometry(const char* segment) {
+
+	header    = reinterpret_cast<const Header*>(segment);
+	triangles = reinterpret_cast<const Triangle*>(segment + sizeof(Header));
+	nodes     = reinterpret_cast<const Node*>(triangles + header->numberOfElements);
+	order     = reinterpret_cast<const int32_t*>(nodes + header->numberOfNodes);
+
+}
+
+inline size_t FlatGeometry::bytes(long int numberOfElements, long int numberOfNodes) {
+	return sizeof(Header) + numberOfElements * (sizeof(Triangle) + sizeof(int32_t)) + numberOfNodes * sizeof(Node);
+}
+
+inline void FlatGeometry::fill(long int index, TriangleElement<double>& element) const {
+
+	const Triangle& t = triangles[index];
+
+	for (int v = 0; v < 3; ++v) {
+		element.vertices[v] = Eigen::Vector3d(t.vertices[v][0], t.vertices[v][1], t.vertices[v][2]);
+	}
+	element.normal = Eigen::Vector3d(t.normal[0], t.normal[1], t.normal[2]);
+	element.ID     = t.ID;
+
+}
+
+inline void FlatGeometry::getElement(long int index, TriangleElement<double>& element) const {
+
+	element.vertices.resize(3);
+	fill(index, element);
+
+}
+
+inline int32_t FlatGeometry::buildNode(const std::vector<Triangle>& tris, std::vector<double>& centroids,
+                                       std::vector<int32_t>& order, int32_t first, int32_t last, std::vector<Node>& nodes) {
+
+	Node   node;
+	double cMin[3], cMax[3];
+	for (int d = 0; d < 3; ++d) {
+		node.minX[d] =  std::numeric_limits<double>::max();
+		node.maxX[d] = -std::numeric_limits<double>::max();
+		cMin[d]      =  std::numeric_limits<double>::max();
+		cMax[d]      = -std::numeric_limits<double>::max();
+	}
+
+	for (int32_t i = first; i < last; ++i) {
+		const Triangle& t = tris[order[i]];
+		for (int d = 0; d < 3; ++d) {
+			for (int v = 0; v < 3; ++v) {
+				node.minX[d] = std::min(node.minX[d], t.vertices[v][d]);
+				node.maxX[d] = std::max(node.maxX[d], t.vertices[v][d]);
+			}
+			cMin[d] = std::min(cMin[d], centroids[3*order[i] + d]);
+			cMax[d] = std::max(cMax[d], centroids[3*order[i] + d]);
+		}
+	}
+
+	int32_t self = nodes.size();
+	node.first = first;
+	node.count = last - first;
+	node.left  = -1;
+	node.right = -1;
+	nodes.push_back(node);
+
+	if (last - first <= leafSize)
+		return self;
+
+	int axis = 0;
+	for (int d = 1; d < 3; ++d) {
+		if (cMax[d] - cMin[d] > cMax[axis] - cMin[axis])
+			axis = d;
+	}
+
+	int32_t middle = first + (last - first) / 2;
+	std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + last,
+	                 [&](int32_t a, int32_t b) { return centroids[3*a + axis] < centroids[3*b + axis]; });
+
+	int32_t left  = buildNode(tris, centroids, order, first, middle, nodes);
+	int32_t right = buildNode(tris, centroids, order, middle, last, nodes);
+
+	nodes[self].count = 0;
+	nodes[self].left  = left;
+	nodes[self].right = right;
+
+	return self;
+
+}
+
+inline void FlatGeometry::buildTree(const std::vector< TriangleElement<double> >& elements, std::vector<Node>& nodes, std::vector<int32_t>& order) {
+
+	std::vector<Triangle> tris(elements.size());
+	std::vector<double>   centroids(3 * elements.size());
+
+	for (size_t i = 0; i < elements.size(); ++i) {
+		for (int v = 0; v < 3; ++v) {
+			for (int d = 0; d < 3; ++d) {
+				tris[i].vertices[v][d] = elements[i].vertices[v][d];
+				centroids[3*i + d]    += elements[i].vertices[v][d] / 3.0;
+			}
+		}
+	}
+
+	order.resize(elements.size());
+	for (size_t i = 0; i < order.size(); ++i) {
+		order[i] = i;
+	}
+
+	nodes.clear();
+	if (!elements.empty()) {
+		nodes.reserve(2 * elements.size() / leafSize + 1);
+		buildNode(tris, centroids, order, 0, elements.size(), nodes);
+	}
+
+}
+
+inline void FlatGeometry::write(const std::vector< TriangleElement<double> >& elements, const Box<double, 3>& aabb,
+                                const std::vector<Node>& nodes, const std::vector<int32_t>& order, char* segment) {
+
+	Header h;
+	h.magic            = magicNumber;
+	h.numberOfElements = elements.size();
+	h.numberOfNodes    = nodes.size();
+	for (int d = 0; d < 3; ++d) {
+		h.minX[d] = aabb.minX(d);
+		h.maxX[d] = aabb.maxX(d);
+	}
+	std::memcpy(segment, &h, sizeof(Header));
+
+	Triangle* tris = reinterpret_cast<Triangle*>(segment + sizeof(Header));
+	for (size_t i = 0; i < elements.size(); ++i) {
+		for (int v = 0; v < 3; ++v) {
+			for (int d = 0; d < 3; ++d) {
+				tris[i].vertices[v][d] = elements[i].vertices[v][d];
+			}
+		}
+		for (int d = 0; d < 3; ++d) {
+			tris[i].normal[d] = elements[i].normal[d];
+		}
+		tris[i].ID = elements[i].ID;
+	}
+
+	char* rest = reinterpret_cast<char*>(tris + elements.size());
+	std::memcpy(rest, nodes.data(), nodes.size() * sizeof(Node));
+	std::memcpy(rest + nodes.size() * sizeof(Node), order.data(), order.size() * sizeof(int32_t));
+
+}
+
+inline double FlatGeometry::boxDistance(const Node& node, const Eigen::Vector3d& point) {
+
+	double distance = 0;
+	for (int d = 0; d < 3; ++d) {
+		double outside = std::max(0.0, std::max(node.minX[d] - point[d], point[d] - node.maxX[d]));
+		distance += outside * outside;
+	}
+
+	return distance;
+
+}
+
+inline double FlatGeometry::computeDistance(const Eigen::Vector3d& point, long int first, long int last,
+                                            long int& closestID, Eigen::Vector3d& closestPoint, double& perpDistance) const {
+
+	double eps = my_eps;
+
+	SignedDistance<double> distance;
+	distance.dist = std::numeric_limits<double>::max();
+	distance.sign = 1;
+	perpDistance  = -std::numeric_limits<double>::max();
+	closestID     = -1;
+
+	if (header->numberOfNodes == 0)
+		return distance.dist;
+
+	TriangleElement<double> element( point );
+
+	// nearer child first, a node is skipped once it can not hold a distance within the tie tolerance
+	int32_t stack[128];
+	int     top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+
+		double bound = distance.dist + eps;
+		if (bound < std::numeric_limits<double>::max() && boxDistance(node, point) > bound * bound)
+			continue;
+
+		if (node.count == 0) {
+			double dl = boxDistance(nodes[node.left], point);
+			double dr = boxDistance(nodes[node.right], point);
+			stack[top++] = (dl < dr) ? node.right : node.left;
+			stack[top++] = (dl < dr) ? node.left  : node.right;
+			continue;
+		}
+
+		for (int32_t i = node.first; i < node.first + node.count; ++i) {
+			if (order[i] < first || order[i] >= last)
+				continue;
+
+			fill(order[i], element);
+
+			SignedDistance<double> currentDistance     = TriangleElement<double>::computeDistance(element, point);
+			double                 currentPerpDistance = TriangleElement<double>::computePerpendicularDistance(element, point);
+
+			// the tree order differs from the element order, equal candidates go to the later element as in the element loop
+			if ( std::abs( currentDistance.dist - distance.dist ) < eps  ) {
+				if ( perpDistance < currentPerpDistance || (perpDistance == currentPerpDistance && element.ID > closestID) ) {
+					distance     = currentDistance;
+					perpDistance = currentPerpDistance;
+					closestID    = element.ID;
+				}
+			} else if ( currentDistance.dist < distance.dist ) {
+				distance     = currentDistance;
+				perpDistance = currentPerpDistance;
+				closestID    = element.ID;
+			}
+		}
+	}
+
+	closestPoint = distance.minPoint;
+	return distance.dist * distance.sign;
+
+}
+
+inline void FlatGeometry::overlapping(const Box<double, 3>& box, long int first, long int last, std::vector<long int>& found) const {
+
+	if (header->numberOfNodes == 0)
+		return;
+
+	int32_t stack[128];
+	int     top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+
+		bool touches = true;
+		for (int d = 0; d < 3; ++d) {
+			touches &= (node.minX[d] <= box.maxX(d)) && (node.maxX[d] >= box.minX(d));
+		}
+		if (!touches)
+			continue;
+
+		if (node.count == 0) {
+			stack[top++] = node.right;
+			stack[top++] = node.left;
+			continue;
+		}
+
+		for (int32_t i = node.first; i < node.first + node.count; ++i) {
+			if (order[i] < first || order[i] >= last)
+				continue;
+
+			const Triangle& t = triangles[order[i]];
+
+			bool inside = true;
+			for (int d = 0; d < 3; ++d) {
+				double lo = std::min(t.vertices[0][d], std::min(t.vertices[1][d], t.vertices[2][d]));
+				double hi = std::max(t.vertices[0][d], std::max(t.vertices[1][d], t.vertices[2][d]));
+				inside &= (lo <= box.maxX(d)) && (hi >= box.minX(d));
+			}
+			if (inside)
+				found.push_back(order[i]);
+		}
+	}
+
+	std::sort(found.begin(), found.end());
+
+}
+
+#endif /* FLATGEOMETRY_HPP_ */
@@ -0,0 +1,183 @@
+/*
+ * FmmHeap.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef FMMHEAP_HPP_
+#define FMMHEAP_HPP_
+
+#include <vector>
+#include <cstddef>
+
+
+/// \brief Indexed 4-ary min heap used as the narrow band of the fast marching method.
+///
+/// Nodes are stored in one flat array, the heap slot of every cell is kept in a compact
+/// side array of back-pointers. This gives decrease-key without searching and without
+/// any per-node allocation. Four children per node halve the depth of the heap compared
+/// to binary heap and the children share one cache line.
+///
+/// \tparam precision type used to store and compare the keys (float or double)
+template <typename precision>
+class FmmHeap {
+
+	struct Node {
+		precision key;
+		int       cell;
+	};
+
+	/// heap ordered nodes
+	std::vector<Node> nodes;
+
+	/// heap slot of every cell, -1 for cells not in the heap
+	std::vector<int>  position;
+
+	void siftUp(size_t slot);
+	void siftDown(size_t slot);
+
+	inline void place(size_t slot, const Node& node) {
+		nodes[slot]              = node;
+		position[node.cell]      = slot;
+	}
+
+public:
+
+	/// \param numberOfCells number of cells the heap can index, cells are numbered 0 .. numberOfCells-1
+	FmmHeap(long int numberOfCells) : position(numberOfCells, -1) {};
+
+	bool empty() const {
+		return nodes.empty();
+	}
+
+	size_t size() const {
+		return nodes.size();
+	}
+
+	bool contains(long int cell) const {
+		return position[cell] >= 0;
+	}
+
+	precision topKey() const {
+		return nodes[0].key;
+	}
+
+	/// insert the cell or decrease its key if it is already queued, larger keys are ignored
+	void push(long int cell, precision key);
+
+	/// remove the cell with the smallest key and return it
+	long int pop();
+
+	/// remove all cells from the heap, keeps the allocated memory
+	void clear();
+
+	/// index more cells, the new ones are not in the heap, used when the cells are allocated during the march
+	void resize(long int numberOfCells) {
+		position.resize(numberOfCells, -1);
+	}
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+template <typename precision>
+void FmmHeap<precision>::push(long int cell, precision key) {
+
+	int slot = position[cell];
+
+	if ( slot < 0 ) {
+		Node node = {key, int(cell)};
+		nodes.push_back(node);
+		position[cell] = nodes.size() - 1;
+		siftUp(nodes.size() - 1);
+	} else if ( key < nodes[slot].key ) {
+		nodes[slot].key = key;
+		siftUp(slot);
+	}
+
+}
+
+template <typename precision>
+long int FmmHeap<precision>::pop() {
+
+	long int cell = nodes[0].cell;
+	position[cell] = -1;
+
+	Node last = nodes.back();
+	nodes.pop_back();
+
+	if ( !nodes.empty() ) {
+		place(0, last);
+		siftDown(0);
+	}
+
+	return cell;
+
+}
+
+template <typename precision>
+void FmmHeap<precision>::clear() {
+
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		position[nodes[i].cell] = -1;
+	}
+
+	nodes.clear();
+
+}
+
+template <typename precision>
+void FmmHeap<precision>::siftUp(size_t slot) {
+
+	Node node = nodes[slot];
+
+	while ( slot > 0 ) {
+		size_t parent = (slot - 1) / 4;
+
+		if ( !(node.key < nodes[parent].key) )
+			break;
+
+		place(slot, nodes[parent]);
+		slot = parent;
+	}
+
+	place(slot, node);
+
+}
+
+template <typename precision>
+void FmmHeap<precision>::siftDown(size_t slot) {
+
+	Node   node = nodes[slot];
+	size_t sz   = nodes.size();
+
+	while ( true ) {
+		size_t first = 4*slot + 1;
+
+		if ( first >= sz )
+			break;
+
+		// pick the smallest of up to four children
+		size_t last     = (first + 4 < sz) ? first + 4 : sz;
+		size_t smallest = first;
+		for (size_t c = first + 1; c < last; ++c) {
+			if ( nodes[c].key < nodes[smallest].key )
+				smallest = c;
+		}
+
+		if ( !(nodes[smallest].key < node.key) )
+			break;
+
+		place(slot, nodes[smallest]);
+		slot = smallest;
+	}
+
+	place(slot, node);
+
+}
+
+#endif /* FMMHEAP_HPP_ */
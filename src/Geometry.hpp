@@ -8,6 +8,7 @@
 #include <list>
 #include <map>
 #include <limits>
+#include <memory>
 #include <spatial/point_multiset.hpp>
 #include <spatial/metric.hpp>
 #include <spatial/bits/spatial_region.hpp>
@@ -18,6 +19,8 @@
 #include "TriangleElement.hpp"
 #include "BoundingBox.hpp"
 #include "SearchGrid.hpp"
+#include "FlatGeometry.hpp"
+#include "GeometryCache.hpp"
 
 
 
@@ -44,6 +47,9 @@ private:
 	/// The number of elements
 	long int numberOfElements;
 
+	/// ID of the first held element, the group keeps only a part of the geometry, see keepGroup
+	long int elementOffset;
+
 	int _numberOfCellsPerTask;
 
 	elementsList_type elements;
@@ -51,6 +57,14 @@ private:
 	bool searchInit;
 	triagTree_type triagIndex;
 
+	/// elements and search tree in a segment shared by the ranks of the node, see fromFileShared
+	/// and fromFileCached, the own elements and triagIndex are empty then
+	FlatGeometry               flat;
+	std::shared_ptr<const char> segment;  ///< keeps the window or the mapping of flat
+
+	/// uses the segment instead of the own elements
+	void attach(const std::shared_ptr<const char>& segment);
+
 	friend std::ostream& operator<<(std::ostream& os, const Geometry& geom);
 
 
@@ -62,12 +76,14 @@ public:
 
 	Geometry() : dim(3),
                  numberOfElements(0),
+                 elementOffset(0),
                  _numberOfCellsPerTask(0),
                  searchInit(false) {}
 
 
 	template <typename iterator>
 	Geometry(iterator it_begin, iterator it_end, const BB_type& span) : dim(span.dims()),
+																		elementOffset(0),
 																		aabb(span),
 																		_numberOfCellsPerTask(0),
 																		searchInit(false) {
@@ -77,9 +93,12 @@ public:
 
 	Geometry(const Geometry& geom): dim(geom.dim),
 			                        numberOfElements(geom.numberOfElements),
+			                        elementOffset(geom.elementOffset),
 			                        aabb(geom.aabb),
 			                        _numberOfCellsPerTask(geom._numberOfCellsPerTask),
-			                        searchInit(false) {
+			                        searchInit(false),
+			                        flat(geom.flat),
+			                        segment(geom.segment) {
 		elements = geom.elements;
 	}
 
@@ -94,6 +113,10 @@ public:
 
 	void preSortElements(const Box<double, 3>& localRegion, double dx, int numberOfSubGroups, int groupID);
 
+	/// Keeps only the elements of the group, groups hold contiguous parts of the geometry.
+	/// Global AABB and element IDs stay, so the distances of the groups can be merged.
+	void keepGroup(int numberOfGroups, int groupID);
+
 	int getNumberOfCellsPerDomainLocal() const;
 
 
@@ -106,16 +129,29 @@ public:
 		return numberOfElements;
 	};
 
+	/// element of the held part, only for the geometry owning its elements
 	const TriangleElement<double>& getElement(int ind) const {
 		return elements[ind];
 	}
 
+	/// element of the held part, own elements are returned as they are, elements of the shared
+	/// segment are copied into element, which the caller keeps across the calls
+	const TriangleElement<double>& getElement(int ind, TriangleElement<double>& element) const {
+		if ( flat.empty() )
+			return elements[ind];
+
+		flat.getElement(elementOffset + ind, element);
+		return element;
+	}
+
 
 
 	const elementsList_type::const_iterator getElementsIterator() const;
 	const elementsList_type::const_iterator getElementsEndIterator() const;
 
 	double computeDistance(const Eigen::Vector3d& point, bool acc);
+	/// signed distance, the closest element and the closest point on it are returned via arguments
+	double computeDistance(const Eigen::Vector3d& point, bool acc, long int& closestID, Eigen::Vector3d& closestPoint);
 	void computeDistance(const std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >& points,
 							   cDistance distances[]);
 
@@ -123,6 +159,20 @@ public:
 	// Factory method to load geometry from STL file
 	static Geometry fromFile(const char* iname, double enlargeBoundingBox);
 
+	/// Loads the geometry once per node into an MPI shared memory window, the other ranks of the node
+	/// map it read only. The search tree is built in the window too, initSearchAccelerator does nothing.
+	///
+	/// \param comm ranks loading the geometry, collective
+	static Geometry fromFileShared(const char* iname, double enlargeBoundingBox, MPI_Comm comm);
+
+	/// Loads the geometry from the cache file, the first rank of comm rebuilds the cache when it was built
+	/// from another content of the STL. The cache is mapped read only, the ranks of the node share its pages.
+	/// Falls back to fromFile when the cache can not be written.
+	///
+	/// \param cache name of the cache file
+	/// \param comm  ranks loading the geometry, collective
+	static Geometry fromFileCached(const char* iname, double enlargeBoundingBox, const char* cache, MPI_Comm comm);
+
 };
 
 
@@ -148,6 +198,17 @@ void Geometry::preSortElements(const Box<double, 3>& localRegion, double dx, int
 	Box<double, 3> lb = localRegion;
 //	lb.grow(1.2);
 
+	if ( !flat.empty() ) {
+		std::vector<long int> found;
+		flat.overlapping(lb, elementOffset, elementOffset + numberOfElements, found);
+
+		for (auto index: found) {
+			localElements.push_back( index - elementOffset );
+		}
+
+		return;
+	}
+
 	regionIterator_type localIter = spatial::region_begin(triagIndex, TrianglePredicate(lb));
 	regionIterator_type endIter = spatial::region_end(triagIndex, TrianglePredicate(lb));
 
@@ -155,7 +216,7 @@ void Geometry::preSortElements(const Box<double, 3>& localRegion, double dx, int
 
 
 	for (; localIter != endIter; ++localIter) {
-		localElements.push_back( (*localIter).ID );
+		localElements.push_back( (*localIter).ID - elementOffset );
 	}
 
 
@@ -179,6 +240,24 @@ void Geometry::preSortElements(const Box<double, 3>& localRegion, double dx, int
 
 }
 
+void Geometry::keepGroup(int numberOfGroups, int groupID) {
+
+	if ( numberOfGroups <= 1 )
+		return;
+
+	long int elementGroupWidth = ceil( double(numberOfElements) / double(numberOfGroups) );
+	long int first             = std::min(elementGroupWidth * groupID, numberOfElements);
+	long int last              = std::min(first + elementGroupWidth, numberOfElements);
+
+	// the shared segment stays whole, only the held range moves
+	if ( flat.empty() )
+		elementsList_type(elements.begin() + first, elements.begin() + last).swap(elements);
+
+	numberOfElements  = last - first;
+	elementOffset    += first;
+
+}
+
 int Geometry::getNumberOfCellsPerDomainLocal() const {
 	return _numberOfCellsPerTask;
 }
@@ -187,6 +266,12 @@ int Geometry::getNumberOfCellsPerDomainLocal() const {
 // Initialize hierarchichal spatial search
 // int his case it is KD-TREE implemented in FLANN library
 void Geometry::initSearchAccelerator() {
+	if ( !flat.empty() ) {
+		// built once per node in the shared segment
+		searchInit = true;
+		return;
+	}
+
 	for (auto& element: elements) {
 		triagIndex.insert( element );
 	}
@@ -213,12 +298,24 @@ inline const std::vector< TriangleElement<double> >::const_iterator Geometry::ge
 }
 
 double Geometry::computeDistance(const Eigen::Vector3d& point, bool acc) {
+	long int        id;
+	Eigen::Vector3d closestPoint;
+
+	return computeDistance(point, acc, id, closestPoint);
+}
+
+double Geometry::computeDistance(const Eigen::Vector3d& point, bool acc, long int& closestID, Eigen::Vector3d& closestPoint) {
 	double eps           =  my_eps;
 	double perpDistance  = -std::numeric_limits<double>::max();
 
 	SignedDistance<double> distance;
 	distance.dist = std::numeric_limits<double>::max();
 
+	if ( !flat.empty() ) {
+		// the tree search is exact, acc does not matter
+		return flat.computeDistance(point, elementOffset, elementOffset + numberOfElements, closestID, closestPoint, perpDistance);
+	}
+
 	if ( searchInit && acc ) {
 
 		// std::cout << "accelerated search" << std::endl;
@@ -254,6 +351,8 @@ double Geometry::computeDistance(const Eigen::Vector3d& point, bool acc) {
 		}
 		// std::cout << "++++++++++++++++++++" << std::endl;
 		// std::cout << "ACC ID = " << id << std::endl;
+		closestID    = id;
+		closestPoint = distance.minPoint;
 		return distance.dist * distance.sign;
 
 	} else {
@@ -277,6 +376,8 @@ double Geometry::computeDistance(const Eigen::Vector3d& point, bool acc) {
 		}
 		// std::cout << "ID = " << id << std::endl;
 		// std::cout << elements[id].getBoundingBox() << std::endl;
+		closestID    = id;
+		closestPoint = distance.minPoint;
 		return distance.dist * distance.sign;
 
 	}
@@ -297,7 +398,17 @@ void Geometry::computeDistance(
 
 	std::cout << "compute distance" << std::endl;
 
-	if ( searchInit ) {
+	if ( !flat.empty() ) {
+
+		for (size_t i = 0; i < points.size(); ++i) {
+			long int        id;
+			Eigen::Vector3d closestPoint;
+
+			distances[i].signedDistance = flat.computeDistance(points[i], elementOffset, elementOffset + numberOfElements,
+			                                                   id, closestPoint, distances[i].pDistance);
+		}
+
+	} else if ( searchInit ) {
 
 		int i = 0;
 		std::cout << "accelerated search" << std::endl;
@@ -490,6 +601,119 @@ Geometry Geometry::fromFile(const char* iname, double enlargeBoundingBox) {
 };
 
 
+/// factory method to load the data once per node into shared memory
+Geometry Geometry::fromFileShared(const char* iname, double enlargeBoundingBox, MPI_Comm comm) {
+
+	int rank, nodeRank;
+	MPI_Comm_rank(comm, &rank);
+
+	MPI_Comm node;
+	MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+	MPI_Comm_rank(node, &nodeRank);
+
+	// only the first rank of the node loads the file and builds the tree
+	Geometry                        loaded = (nodeRank == 0) ? fromFile(iname, enlargeBoundingBox) : Geometry();
+	std::vector<FlatGeometry::Node> nodes;
+	std::vector<int32_t>            order;
+	MPI_Aint                        size = 0;
+
+	if (nodeRank == 0) {
+		FlatGeometry::buildTree(loaded.elements, nodes, order);
+		size = FlatGeometry::bytes(loaded.elements.size(), nodes.size());
+	}
+
+	char*   segment;
+	MPI_Win win;
+	MPI_Win_allocate_shared(size, 1, MPI_INFO_NULL, node, &segment, &win);
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+
+	if (nodeRank == 0) {
+		FlatGeometry::write(loaded.elements, loaded.aabb, nodes, order, segment);
+	}
+
+	MPI_Win_sync(win);
+	MPI_Barrier(node);
+	MPI_Win_sync(win);
+
+	if (nodeRank != 0) {
+		int      unit;
+		MPI_Win_shared_query(win, 0, &size, &unit, &segment);
+	}
+
+	// window and its communicator go with the last copy of the geometry, unless MPI is gone already
+	Geometry geom;
+	geom.attach( std::shared_ptr<const char>(segment, [win, node](const char*) {
+		MPI_Win  w = win;
+		MPI_Comm c = node;
+		int      finalized;
+		MPI_Finalized(&finalized);
+		if (!finalized) {
+			MPI_Win_unlock_all(w);
+			MPI_Win_free(&w);
+			MPI_Comm_free(&c);
+		}
+	}) );
+
+	return geom;
+
+}
+
+
+/// factory method to load the data from the cache, rebuilt from the stl file when out of date
+Geometry Geometry::fromFileCached(const char* iname, double enlargeBoundingBox, const char* cache, MPI_Comm comm) {
+
+	int rank, ready = 0;
+	MPI_Comm_rank(comm, &rank);
+
+	if (rank == 0) {
+		uint64_t hash, size;
+
+		if ( GeometryCache::hashFile(iname, hash, size) ) {
+			ready = GeometryCache::matches(cache, hash, size, enlargeBoundingBox);
+
+			if ( !ready ) {
+				Geometry                        loaded = fromFile(iname, enlargeBoundingBox);
+				std::vector<FlatGeometry::Node> nodes;
+				std::vector<int32_t>            order;
+
+				FlatGeometry::buildTree(loaded.elements, nodes, order);
+				ready = GeometryCache::write(cache, hash, size, enlargeBoundingBox, loaded.elements, loaded.aabb, nodes, order);
+			}
+		}
+	}
+
+	MPI_Bcast(&ready, 1, MPI_INT, 0, comm);
+
+	std::shared_ptr<const char> mapped;
+	if ( ready )
+		mapped = GeometryCache::map(cache);
+
+	if ( !mapped ) {
+		std::cerr << "Geometry cache " << cache << " not usable, loading " << iname << std::endl;
+		return fromFile(iname, enlargeBoundingBox);
+	}
+
+	Geometry geom;
+	geom.attach(mapped);
+
+	return geom;
+
+}
+
+
+inline void Geometry::attach(const std::shared_ptr<const char>& segment) {
+
+	this->segment    = segment;
+	flat             = FlatGeometry(segment.get());
+	numberOfElements = flat.getNumberOfElements();
+	elementOffset    = 0;
+	aabb             = flat.getAABB();
+
+	elementsList_type().swap(elements);
+
+}
+
+
 
 
 //==========================================
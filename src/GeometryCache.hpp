@@ -0,0 +1,203 @@
+/*
+ * GeometryCache.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef GEOMETRYCACHE_HPP_
+#define GEOMETRYCACHE_HPP_
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "FlatGeometry.hpp"
+
+
+/// header of the geometry cache file
+struct GeometryCacheHeader {
+	char     magic[8];
+	int32_t  version;             ///< layout of the FlatGeometry segment
+	int32_t  reserved;
+	uint64_t sourceHash;          ///< FNV-1a of the STL file
+	uint64_t sourceSize;
+	double   enlargeBoundingBox;  ///< the aabb of the segment is grown by it
+	int64_t  segmentOffset;
+	int64_t  segmentBytes;
+};
+
+static_assert(sizeof(GeometryCacheHeader) == 56, "GeometryCacheHeader must not be padded");
+
+static const char geometryCacheMagic[8] = {'L', 'S', 'G', 'C', 'A', 'C', 'H', 'E'};
+
+
+/// \brief Binary cache of the loaded geometry and its search tree, see Geometry::fromFileCached
+///
+/// The file holds the FlatGeometry segment behind a header keyed by the content hash of the STL.
+/// A matching cache is mapped read only with no parsing, the pages come from the page cache and are
+/// shared by all ranks of the node. Any other version, source or bounding box growth rebuilds it.
+///
+///   GeometryCacheHeader
+///   FlatGeometry segment at segmentOffset
+class GeometryCache {
+
+	static const int32_t version = 1;
+
+	/// segment starts on its own cache line
+	static int64_t segmentOffset() {
+		return 64;
+	}
+
+public:
+
+	/// FNV-1a hash of the file content, false when it can not be read
+	static bool hashFile(const char* file, uint64_t& hash, uint64_t& size);
+
+	/// true when the cache exists and was built from the same source
+	static bool matches(const char* cache, uint64_t hash, uint64_t size, double enlargeBoundingBox);
+
+	/// writes the cache next to it first and renames it, so a reader never sees a partial file
+	static bool write(const char* cache, uint64_t hash, uint64_t size, double enlargeBoundingBox,
+	                  const std::vector< TriangleElement<double> >& elements, const Box<double, 3>& aabb,
+	                  const std::vector<FlatGeometry::Node>& nodes, const std::vector<int32_t>& order);
+
+	/// maps the segment of the cache read only, empty pointer on failure, the mapping goes with the last copy
+	static std::shared_ptr<const char> map(const char* cache);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+inline bool GeometryCache::hashFile(const char* file, uint64_t& hash, uint64_t& size) {
+
+	FILE* fp = fopen(file, "rb");
+	if ( fp == NULL )
+		return false;
+
+	hash = 14695981039346656037ull;
+	size = 0;
+
+	std::vector<unsigned char> buffer(1 << 20);
+	for (size_t n = fread(buffer.data(), 1, buffer.size(), fp); n > 0; n = fread(buffer.data(), 1, buffer.size(), fp)) {
+		for (size_t i = 0; i < n; ++i) {
+			hash ^= buffer[i];
+			hash *= 1099511628211ull;
+		}
+		size += n;
+	}
+
+	fclose(fp);
+
+	return true;
+
+}
+
+inline bool GeometryCache::matches(const char* cache, uint64_t hash, uint64_t size, double enlargeBoundingBox) {
+
+	GeometryCacheHeader header;
+
+	FILE* fp = fopen(cache, "rb");
+	if ( fp == NULL )
+		return false;
+
+	bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+	          memcmp(header.magic, geometryCacheMagic, sizeof(geometryCacheMagic)) == 0 &&
+	          header.version            == version &&
+	          header.sourceHash         == hash &&
+	          header.sourceSize         == size &&
+	          header.enlargeBoundingBox == enlargeBoundingBox;
+
+	// a cut file is rebuilt as well
+	if ( ok ) {
+		fseek(fp, 0, SEEK_END);
+		ok = long(header.segmentOffset + header.segmentBytes) <= ftell(fp);
+	}
+
+	fclose(fp);
+
+	return ok;
+
+}
+
+inline bool GeometryCache::write(const char* cache, uint64_t hash, uint64_t size, double enlargeBoundingBox,
+                                 const std::vector< TriangleElement<double> >& elements, const Box<double, 3>& aabb,
+                                 const std::vector<FlatGeometry::Node>& nodes, const std::vector<int32_t>& order) {
+
+	GeometryCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, geometryCacheMagic, sizeof(geometryCacheMagic));
+	header.version            = version;
+	header.sourceHash         = hash;
+	header.sourceSize         = size;
+	header.enlargeBoundingBox = enlargeBoundingBox;
+	header.segmentOffset      = segmentOffset();
+	header.segmentBytes       = FlatGeometry::bytes(elements.size(), nodes.size());
+
+	std::vector<char> data(header.segmentOffset + header.segmentBytes, 0);
+	memcpy(data.data(), &header, sizeof(header));
+	FlatGeometry::write(elements, aabb, nodes, order, data.data() + header.segmentOffset);
+
+	std::string tmp = std::string(cache) + ".tmp";
+
+	FILE* fp = fopen(tmp.c_str(), "wb");
+	if ( fp == NULL )
+		return false;
+
+	bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+	ok      = (fclose(fp) == 0) && ok;
+
+	if ( !ok || rename(tmp.c_str(), cache) != 0 ) {
+		remove(tmp.c_str());
+		return false;
+	}
+
+	return true;
+
+}
+
+inline std::shared_ptr<const char> GeometryCache::map(const char* cache) {
+
+	int fd = open(cache, O_RDONLY);
+	if ( fd < 0 )
+		return std::shared_ptr<const char>();
+
+	struct stat st;
+	if ( fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(GeometryCacheHeader) ) {
+		close(fd);
+		return std::shared_ptr<const char>();
+	}
+
+	size_t length = st.st_size;
+	void*  base   = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if ( base == MAP_FAILED )
+		return std::shared_ptr<const char>();
+
+	const GeometryCacheHeader* header = static_cast<const GeometryCacheHeader*>(base);
+	if ( size_t(header->segmentOffset + header->segmentBytes) > length ) {
+		munmap(base, length);
+		return std::shared_ptr<const char>();
+	}
+
+	std::shared_ptr<const char> mapping(static_cast<const char*>(base), [length](const char* p) {
+		munmap(const_cast<char*>(p), length);
+	});
+
+	// points to the segment, owns the whole mapping
+	return std::shared_ptr<const char>(mapping, mapping.get() + header->segmentOffset);
+
+}
+
+#endif /* GEOMETRYCACHE_HPP_ */
@@ -10,6 +10,7 @@
 
 #include <cmath>
 #include <vector>
+#include <algorithm>
 #include <string>
 #include <sstream>
 #include <petscdmda.h>
@@ -89,6 +90,21 @@ struct GridData {
 
 
 
+/**
+ * @brief Vectors and scatter for writing the grid into a single file on rank 0
+ *
+ * Created with the first write and kept by the grid, so the time series output does not
+ * rebuild the natural ordering scatter for every step. Destroyed with the grid.
+ */
+struct GridOutputContext {
+    Vec        global;  ///< global vector of the grid
+    Vec        natural; ///< global vector in natural order
+    Vec        root;    ///< whole natural vector on rank 0, empty on the others
+    VecScatter toRoot;  ///< natural -> root
+};
+
+
+
 /**
  * @brief Grid class wrapping PETSc DMDA grid
  * @tparam type int or double
@@ -97,9 +113,9 @@ struct GridData {
 template <typename type, PetscInt dim>
 class Grid {
 
-    MPI_Datatype mpi_grid_type;
-
-    GridData* globalGridLayout; ///< Stores information about the global grid distribution
+    // first node owned by each process along each dimension, one extra entry for the end,
+    // layout of any process is computed from these, see getLayout
+    std::vector<PetscInt> ownershipStart[3];
 
     // grid step size, with appropriate length
     type dx[dim]; ///< deprecated, todo remove
@@ -155,6 +171,9 @@ class Grid {
     // duplicate info for storing type of the boundary (NONE, GHOSTED, MIRRORED, PERIODIC)
     DMDABoundaryType boundaryType;
 
+    // output buffers, made on demand by getOutputContext
+    mutable GridOutputContext* outputContext;
+
 
     //==========================
     // Private helper function
@@ -166,8 +185,10 @@ class Grid {
     * \param *maxX array containing upper point of the grid
     * \param *M    array with number of grid cells in each direction
     * \param *NP   array with number of slices in each direction
+    * \param *lx, *ly, *lz number of nodes owned by the slices, PETSC_NULL leaves the split on PETSc
     */
-    void init(PetscReal* minX, PetscReal* maxX, PetscInt* M, PetscInt* NP);
+    void init(PetscReal* minX, PetscReal* maxX, PetscInt* M, PetscInt* NP,
+              const PetscInt* lx = PETSC_NULL, const PetscInt* ly = PETSC_NULL, const PetscInt* lz = PETSC_NULL);
 
     /**
      * \brief Friend ostream operator for debug print
@@ -191,6 +212,16 @@ public:
     Grid(PetscReal* minX, PetscReal* maxX, PetscInt* M, PetscInt* NP);
 
 
+    /// Constructor with given ownership ranges, see Decomposition
+    ///
+    /// \param *minX array containing lower point of the grid
+    /// \param *maxX array containing upper point of the grid
+    /// \param *M    array with number of grid cells in each direction
+    /// \param *NP   array with number of slices in each direction
+    /// \param *lx, *ly, *lz number of nodes owned by the slices in each direction
+    Grid(PetscReal* minX, PetscReal* maxX, PetscInt* M, PetscInt* NP, const PetscInt* lx, const PetscInt* ly, const PetscInt* lz);
+
+
     /// Constructor for new interface, utilizes Eigen classes
     ///
     /// \param minX array containing lower point of the grid
@@ -220,6 +251,12 @@ public:
 
     const DM getDA() const {return this->da;};
 
+    /// vectors and scatter for writing the whole grid on rank 0, made with the first call
+    GridOutputContext& getOutputContext() const;
+
+    /// layout of the grid part owned by given process, computed from the DMDA ownership ranges
+    GridData getLayout(int procID) const;
+
 
     /// returns minimum coordinate of the grid for asked dimension number
     PetscReal getMin(PetscInt dimNum) const;
@@ -257,14 +294,19 @@ public:
     /// return linear index from passed matrix indices (linear index is defined in row wise manner)
     long int getLinearIndex(std::vector<PetscInt> ind) const;
 
+    /// get coordinate from global indices, the grid is uniform so nothing is stored
+    Eigen::Vector3d getCoord(PetscInt i, PetscInt j, PetscInt k) const {
+        return Eigen::Vector3d(minX[0] + i*dx[0], minX[1] + j*dx[1], minX[2] + k*dx[2]);
+    }
+
     /// get coordinate from indices
     inline Eigen::Vector3d getCoord(const Eigen::Vector3i& ind) const;
 
     /// get coordinate from indices
     const std::vector<PetscReal> getLocalCoord(std::vector<PetscInt> ind) const;
 
-    /// get local coordinate from indices
-    Eigen::Vector3d getLocalCoord(PetscInt* ind, int procID) const;
+    /// get local coordinate from indices in the ghosted block of the layout, see getLayout
+    Eigen::Vector3d getLocalCoord(PetscInt* ind, const GridData& layout) const;
 
     /// get local coordinates from indices
     const std::vector<PetscReal> getLocalCoord(PetscInt* ind) const;
@@ -273,6 +315,17 @@ public:
 
     long int getNumberOfLocalCells() const;
 
+    /// number of cells owned by this node, without the ghost layer
+    long int getNumberOfOwnedCells() const;
+
+    /// MPI subarray type placing the owned block of this node into the global array stored
+    /// in natural order (x fastest), used as file view by the collective writers.
+    /// Caller is responsible for MPI_Type_free.
+    MPI_Datatype createOwnedSubarrayType() const;
+
+    /// rank owning the node with given global indices
+    int getOwner(const PetscInt ind[3]) const;
+
     PetscInt getM(PetscInt dimNum) const;
 
     PetscInt getLocalM(PetscInt dimNum) const;
@@ -291,6 +344,9 @@ public:
 
     std::list<int> getProcessSpan(const Box<double, dim>& indBox) const;
 
+    /// ranks whose ghosted block holds any node of the box of global indices
+    std::vector<int> getGhostedOwners(const Box<PetscInt, dim>& indices) const;
+
     Box<double, dim> getNodeSpan(int indices[dim]) const;
 
     Box<double, dim> getNodeSpan() const;
@@ -310,9 +366,10 @@ public:
 
 
 template <typename type, int dim>
-void Grid<type, dim>::init(PetscReal* minX, PetscReal* maxX, PetscInt* M, PetscInt* NP) {
+void Grid<type, dim>::init(PetscReal* minX, PetscReal* maxX, PetscInt* M, PetscInt* NP,
+                           const PetscInt* lx, const PetscInt* ly, const PetscInt* lz) {
 
-    GridData::createType(&mpi_grid_type);
+    outputContext = NULL;
 
     PetscErrorCode ierr;
 
@@ -342,8 +399,8 @@ void Grid<type, dim>::init(PetscReal* minX, PetscReal* maxX, PetscInt* M, PetscI
             // To make petsc work correctly, we need to convert number of gridcells to number of nodes => M[.] = M[.] + 1
             ierr = DMDACreate3d(PETSC_COMM_WORLD, boundaryType, boundaryType, boundaryType, DMDA_STENCIL_BOX,
                                     M[0], M[1], M[2], NP[0], NP[1], NP[2], dof, stencilSize,
-                                    PETSC_NULL, PETSC_NULL, PETSC_NULL, &da);
-            ierr = DMDASetUniformCoordinates(da, minX[0], maxX[0], minX[1], maxX[1], minX[2], maxX[2]);
+                                    lx, ly, lz, &da);
+            // coordinates are not stored in the DMDA, getCoord computes them from minX and dx
 
             // very stupid way to get back the process layout
             ierr = DMDAGetInfo(da,
@@ -407,42 +464,19 @@ void Grid<type, dim>::init(PetscReal* minX, PetscReal* maxX, PetscInt* M, PetscI
     }
 
 
-    for (int i = 0; i < 3; ++i) {
+    const PetscInt* ranges[3];
+    const int       procs[3] = {pm, pn, pp};
 
-        gr_layout.lminx[i] = localMinX[i];
-        gr_layout.lmaxx[i] = localMaxX[i];
-        gr_layout.glminx[i] = localGhostedMinX[i];
-        gr_layout.glmaxx[i] = localGhostedMaxX[i];
+    DMDAGetOwnershipRanges(da, &ranges[0], &ranges[1], &ranges[2]);
 
+    for (int d = 0; d < 3; ++d) {
+        ownershipStart[d].assign(procs[d] + 1, 0);
+        for (int p = 0; p < procs[d]; ++p) {
+            ownershipStart[d][p + 1] = ownershipStart[d][p] + ranges[d][p];
+        }
     }
 
-    gr_layout.glm = localInfo.gxm;
-    gr_layout.gln = localInfo.gym;
-    gr_layout.glp = localInfo.gzm;
-
-    gr_layout.lm  = localInfo.mx;
-    gr_layout.ln  = localInfo.my;
-    gr_layout.lp  = localInfo.mz;
-
-    gr_layout.m   = M[0];
-    gr_layout.n   = M[1];
-    gr_layout.p   = M[2];
-
-    gr_layout.minx[0] = minX[0];
-    gr_layout.minx[1] = minX[1];
-    gr_layout.minx[2] = minX[2];
-
-    gr_layout.maxx[0] = maxX[0];
-    gr_layout.maxx[1] = maxX[1];
-    gr_layout.maxx[2] = maxX[2];
-
-    gr_layout.ghosts = 1;
-
-
-    globalGridLayout = new GridData[nProcs]; // do not forget to delete this little shit
-
-
-    MPI_Allgather(&gr_layout, 1, mpi_grid_type, globalGridLayout, 1, mpi_grid_type, MPI_COMM_WORLD);
+    gr_layout = getLayout(processID);
 
     std::stringstream ss;
     
@@ -450,12 +484,6 @@ void Grid<type, dim>::init(PetscReal* minX, PetscReal* maxX, PetscInt* M, PetscI
     ss << "procid : " << processID << std::endl;
     ss << "min: " << gr_layout.glminx[0] << ", " << gr_layout.glminx[1] << ", " << gr_layout.glminx[2] << std::endl;
     ss << "max: " << gr_layout.glmaxx[0] << ", " << gr_layout.glmaxx[1] << ", " << gr_layout.glmaxx[2] << std::endl;
-    ss << "====================" << std::endl;
-     for (int i = 0; i < nProcs; ++i) {
-        ss << "global proc id : " << i << std::endl;
-        ss << "min: " << globalGridLayout[i].glminx[0] << ", " << globalGridLayout[i].glminx[1] << ", " << globalGridLayout[i].glminx[2] << std::endl;
-        ss << "max: " << globalGridLayout[i].glmaxx[0] << ", " << globalGridLayout[i].glmaxx[1] << ", " << globalGridLayout[i].glmaxx[2] << std::endl;
-     }
     ss << "====================" << std::endl;
 
     std::string s = ss.str();
@@ -523,6 +551,13 @@ Grid<type, dim>::Grid(PetscReal* minX, PetscReal* maxX, PetscInt* M, PetscInt* N
 
 }
 
+template <typename type, int dim>
+Grid<type, dim>::Grid(PetscReal* minX, PetscReal* maxX, PetscInt* M, PetscInt* NP, const PetscInt* lx, const PetscInt* ly, const PetscInt* lz) {
+
+    init(minX, maxX, M, NP, lx, ly, lz);
+
+}
+
 
 
 template <typename type, int dim>
@@ -532,19 +567,106 @@ Grid<type, dim>::~Grid() {
     PetscBool finalized;
     PetscFinalized(&finalized);
 
-    delete [] globalGridLayout;
-
     if (!finalized) {
+        if (outputContext != NULL) {
+            VecScatterDestroy(&outputContext->toRoot);
+            VecDestroy(&outputContext->root);
+            VecDestroy(&outputContext->natural);
+            VecDestroy(&outputContext->global);
+        }
         DMDestroy(&da);
     } // else I am not really sure what happen, will the object stay hanging?
     else {
         std::cout << "already finalized" << std::endl;
     }
 
+    delete outputContext;
+
 }
 
 
 
+template <typename type, int dim>
+GridData Grid<type, dim>::getLayout(int procID) const {
+
+    // PETSc numbers the processes x fastest
+    const int p[3]     = {procID % pm, (procID / pm) % pn, procID / (pm*pn)};
+    const int ghosts   = stencilSize;
+
+    GridData layout;
+    int      counts[3], gcounts[3];
+
+    for (int d = 0; d < 3; ++d) {
+        PetscInt start = ownershipStart[d][p[d]];
+        PetscInt end   = ownershipStart[d][p[d] + 1];
+        // ghosted boundary keeps the ghost layer outside of the domain too
+        PetscInt gstart = start - ghosts;
+        PetscInt gend   = end + ghosts;
+        if (boundaryType == DMDA_BOUNDARY_NONE) {
+            gstart = std::max(gstart, PetscInt(0));
+            gend   = std::min(gend, PetscInt(numberOfGridCells[d]));
+        }
+
+        layout.minx[d]   = minX[d];
+        layout.maxx[d]   = maxX[d];
+        layout.lminx[d]  = minX[d] + start * dx[d];
+        layout.lmaxx[d]  = minX[d] + (end - 1) * dx[d];
+        layout.glminx[d] = minX[d] + gstart * dx[d];
+        layout.glmaxx[d] = minX[d] + (gend - 1) * dx[d];
+
+        counts[d]  = end - start;
+        gcounts[d] = gend - gstart;
+    }
+
+    layout.pm  = pm;
+    layout.pn  = pn;
+    layout.pp  = pp;
+    layout.m   = numberOfGridCells[0];
+    layout.n   = numberOfGridCells[1];
+    layout.p   = numberOfGridCells[2];
+    layout.lm  = counts[0];
+    layout.ln  = counts[1];
+    layout.lp  = counts[2];
+    layout.glm = gcounts[0];
+    layout.gln = gcounts[1];
+    layout.glp = gcounts[2];
+
+    layout.ghosts = ghosts;
+
+    return layout;
+
+}
+
+template <typename type, int dim>
+int Grid<type, dim>::getOwner(const PetscInt ind[3]) const {
+
+    int p[3];
+    for (int d = 0; d < 3; ++d) {
+        p[d] = std::upper_bound(ownershipStart[d].begin(), ownershipStart[d].end() - 1, ind[d]) - ownershipStart[d].begin() - 1;
+    }
+
+    // PETSc numbers the processes x fastest
+    return p[0] + p[1]*pm + p[2]*pm*pn;
+
+}
+
+
+template <typename type, int dim>
+GridOutputContext& Grid<type, dim>::getOutputContext() const {
+
+    if (outputContext == NULL) {
+        outputContext = new GridOutputContext;
+
+        DMCreateGlobalVector(da, &outputContext->global);
+        DMDACreateNaturalVector(da, &outputContext->natural);
+        VecScatterCreateToZero(outputContext->natural, &outputContext->toRoot, &outputContext->root);
+    }
+
+    return *outputContext;
+
+}
+
+
 // this should be removed !!!!!!!!!!!!!
 template <typename type, int dim>
 const DMDALocalInfo* Grid<type, dim>::getLocalInfo() const{
@@ -626,9 +748,7 @@ inline long int Grid<type, dim>::getLinearIndex(std::vector<PetscInt> ind) const
 
 template <typename type, int dim>
 inline Eigen::Vector3d Grid<type, dim>::getCoord(const Eigen::Vector3i& ind) const {
-    Eigen::Vector3d x_lo(minX), x_dx(dx);
-
-    return x_lo + x_dx.cwiseProduct( ind.cast<double>() );
+    return getCoord(ind[0], ind[1], ind[2]);
 }
 
 
@@ -643,10 +763,10 @@ inline const std::vector<PetscReal> Grid<type, dim>::getLocalCoord(PetscInt* ind
 }
 
 template <typename type, int dim>
-inline Eigen::Vector3d Grid<type, dim>::getLocalCoord(PetscInt* ind, int procID) const {
+inline Eigen::Vector3d Grid<type, dim>::getLocalCoord(PetscInt* ind, const GridData& layout) const {
     Eigen::Vector3d coord;
     for (int i = 0; i < dim; ++i) {
-        coord[i] = globalGridLayout[procID].glminx[i] + ind[i]*dx[i];
+        coord[i] = layout.glminx[i] + ind[i]*dx[i];
     }
 
     return coord;
@@ -671,6 +791,29 @@ inline long int Grid<type, dim>::getNumberOfCells() const {
     return numberOfCells;
 }
 
+template <typename type, int dim>
+inline long int Grid<type, dim>::getNumberOfOwnedCells() const {
+
+    return long(localInfo.xm) * localInfo.ym * localInfo.zm;
+
+}
+
+template <typename type, int dim>
+MPI_Datatype Grid<type, dim>::createOwnedSubarrayType() const {
+
+    // C ordered subarray, so the slowest dimension goes first
+    int sizes[3]    = {localInfo.mz, localInfo.my, localInfo.mx};
+    int subsizes[3] = {localInfo.zm, localInfo.ym, localInfo.xm};
+    int starts[3]   = {localInfo.zs, localInfo.ys, localInfo.xs};
+
+    MPI_Datatype subarray;
+    MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &subarray);
+    MPI_Type_commit(&subarray);
+
+    return subarray;
+
+}
+
 template <typename type, int dim>
 inline long int Grid<type, dim>::getNumberOfLocalCells() const {
     long int numberOfCells = 1;
@@ -829,33 +972,39 @@ Box<PetscInt, 3> Grid<type, dim>::locateBoxIndices(const Box<PetscReal, 3>& bb)
 // Returns physical position of the data in question
 template <typename type, int dim>
 int Grid<type, dim>::getDataPosition(const type point[dim]) {
-    Eigen::Array<type, dim, 1> x_lo(minX), p(point), span(nodeSpan), x_hi(maxX);
-    Eigen::Array<int, dim, 1> procs;
 
-    procs << 1, pm, pm*pn;
-
-    auto pos_cor = ((p - x_lo) / span).template cast<int>();
+    PetscInt ind[3];
+    for (int d = 0; d < 3; ++d) {
+        ind[d] = std::floor( (point[d] - minX[d]) / dx[d] + 0.5 );
+        ind[d] = std::max(PetscInt(0), std::min(ind[d], PetscInt(numberOfGridCells[d] - 1)));
+    }
 
-    return (pos_cor*procs).sum();
+    return getOwner(ind);
 
 }
 
 template <typename type, int dim>
 std::list<int> Grid<type, dim>::getProcessSpan(const Box<double, dim>& indBox) const {
-    Eigen::Array<type, dim, 1> x_lo(minX), span(nodeSpan), x_hi(maxX);
-    Eigen::Array<int, dim, 1> procs;
     std::list<int> processes;
     double eps = 1E-10; // this is purely local epsilon need to be machine eps
 
-    procs << 1, pm, pm*pn;
+    // ownership ranges need not be uniform, locate the corner nodes in them
+    PetscInt lo[3], hi[3];
+    for (int d = 0; d < 3; ++d) {
+        lo[d] = std::floor( (indBox.minX(d) - minX[d] - eps) / dx[d] + 0.5 );
+        hi[d] = std::floor( (indBox.maxX(d) - minX[d] - eps) / dx[d] + 0.5 );
+        lo[d] = std::max(PetscInt(0), std::min(lo[d], PetscInt(numberOfGridCells[d] - 1)));
+        hi[d] = std::max(PetscInt(0), std::min(hi[d], PetscInt(numberOfGridCells[d] - 1)));
+    }
 
-    auto pos_cor_bl = ((indBox.bl() - x_lo - eps) / span).template cast<int>();
-    auto pos_cor_tr = ((indBox.tr() - x_lo - eps) / span).template cast<int>();
+    const int first = getOwner(lo), last = getOwner(hi);
+    const int pos_cor_bl[3] = {first % pm, (first / pm) % pn, first / (pm*pn)};
+    const int pos_cor_tr[3] = {last % pm,  (last / pm) % pn,  last / (pm*pn)};
 
     for (int k = pos_cor_bl[2]; k <= pos_cor_tr[2]; ++k) {
         for (int j = pos_cor_bl[1]; j <= pos_cor_tr[1]; ++j) {
             for (int i = pos_cor_bl[0]; i <= pos_cor_tr[0]; ++i) {
-                processes.push_back( (Eigen::Array3i(i,j,k)*procs).sum() );
+                processes.push_back( i + j*pm + k*pm*pn );
             }
         }
     }
@@ -865,6 +1014,33 @@ std::list<int> Grid<type, dim>::getProcessSpan(const Box<double, dim>& indBox) c
 }
 
 
+template <typename type, int dim>
+std::vector<int> Grid<type, dim>::getGhostedOwners(const Box<PetscInt, dim>& indices) const {
+    std::vector<int> owners;
+
+    // the ghost layer of a block reaches stencilSize nodes into its neighbors
+    int first[3], last[3];
+    for (int d = 0; d < 3; ++d) {
+        PetscInt lo = std::max(PetscInt(0), PetscInt(indices.minX(d) - stencilSize));
+        PetscInt hi = std::min(PetscInt(numberOfGridCells[d] - 1), PetscInt(indices.maxX(d) + stencilSize));
+
+        first[d] = std::upper_bound(ownershipStart[d].begin(), ownershipStart[d].end() - 1, lo) - ownershipStart[d].begin() - 1;
+        last[d]  = std::upper_bound(ownershipStart[d].begin(), ownershipStart[d].end() - 1, hi) - ownershipStart[d].begin() - 1;
+    }
+
+    for (int k = first[2]; k <= last[2]; ++k) {
+        for (int j = first[1]; j <= last[1]; ++j) {
+            for (int i = first[0]; i <= last[0]; ++i) {
+                owners.push_back( i + j*pm + k*pm*pn );
+            }
+        }
+    }
+
+    return owners;
+
+}
+
+
 template <typename type, int dim>
 Box<double, dim> Grid<type, dim>::getNodeSpan(int indices[dim]) const {
 
@@ -883,20 +1059,22 @@ Box<double, dim> Grid<type, dim>::getNodeSpan(int indices[dim]) const {
 template <typename type, int dim>
 Box<double, dim> Grid<type, dim>::getNodeSpan() const {
 
-    return Box<double, 3>(globalGridLayout[processID].glminx, globalGridLayout[processID].glmaxx);
+    return Box<double, 3>(gr_layout.glminx, gr_layout.glmaxx);
 
 }
 
 template <typename type, int dim>
 Box<double, dim> Grid<type, dim>::getNodeSpan(int procID) const {
+    const GridData layout = getLayout(procID);
+
     std::stringstream ss;
     ss << "ProcID = " << procID << std::endl;
-    ss << globalGridLayout[procID].glminx[0] << ", " << globalGridLayout[procID].glminx[1] << ", " << globalGridLayout[procID].glminx[2] << std::endl;
-    ss << globalGridLayout[procID].glmaxx[0] << ", " << globalGridLayout[procID].glmaxx[1] << ", " << globalGridLayout[procID].glmaxx[2] << std::endl;
+    ss << layout.glminx[0] << ", " << layout.glminx[1] << ", " << layout.glminx[2] << std::endl;
+    ss << layout.glmaxx[0] << ", " << layout.glmaxx[1] << ", " << layout.glmaxx[2] << std::endl;
     std::string s = ss.str();
     PetscSynchronizedPrintf(PETSC_COMM_WORLD, s.c_str());
     PetscSynchronizedFlush(PETSC_COMM_WORLD);
-    return Box<double, 3>(globalGridLayout[procID].glminx, globalGridLayout[procID].glmaxx);
+    return Box<double, 3>(layout.glminx, layout.glmaxx);
 
 }
 
@@ -905,20 +1083,22 @@ std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > Grid<ty
 
     // std::cout << "proc: " << procID << " , boundaries : " << boundaries << std::endl;
 
+    const GridData layout = getLayout(procID);
+
     std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > cellList;
-    long int reserveSize = (globalGridLayout[procID].glm + globalGridLayout[procID].gln + globalGridLayout[procID].glp) / 3;
+    long int reserveSize = (layout.glm + layout.gln + layout.glp) / 3;
     reserveSize          = reserveSize*reserveSize*4;
 
     cellList.reserve( reserveSize );
 
     if ( boundaries & 1 ) {
         // this means lets initialize left side
-        for (int i = 0; i < globalGridLayout[procID].ghosts; ++i) {
-            for (int j = 0; j < globalGridLayout[procID].gln; ++j) {
-                for (int k = 0; k < globalGridLayout[procID].glp; ++k) {
+        for (int i = 0; i < layout.ghosts; ++i) {
+            for (int j = 0; j < layout.gln; ++j) {
+                for (int k = 0; k < layout.glp; ++k) {
 
                     PetscInt inds[dim]    = {i, j, k};
-                    Eigen::Vector3d coord  = getLocalCoord(inds, procID);
+                    Eigen::Vector3d coord  = getLocalCoord(inds, layout);
                     cellList.push_back(coord);
 
                 }
@@ -927,12 +1107,12 @@ std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > Grid<ty
     }
     if ( boundaries & 2 ) {
         // this means lets initialize right side
-        for (int i = 0; i < globalGridLayout[procID].ghosts; ++i) {
-            for (int j = 0; j < globalGridLayout[procID].gln; ++j) {
-                for (int k = 0; k < globalGridLayout[procID].glp; ++k) {
+        for (int i = 0; i < layout.ghosts; ++i) {
+            for (int j = 0; j < layout.gln; ++j) {
+                for (int k = 0; k < layout.glp; ++k) {
 
-                    PetscInt inds[dim]    = {( globalGridLayout[procID].glm - 1) - i, j, k};
-                    Eigen::Vector3d coord  = getLocalCoord(inds, procID);
+                    PetscInt inds[dim]    = {( layout.glm - 1) - i, j, k};
+                    Eigen::Vector3d coord  = getLocalCoord(inds, layout);
                     cellList.push_back(coord);
 
                 }
@@ -941,12 +1121,12 @@ std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > Grid<ty
     }
     if ( boundaries & 4 ) {
         // this means initialize the bottom side
-        for (int j = 0; j < globalGridLayout[procID].ghosts; ++j) {
-            for (int i = 0; i < globalGridLayout[procID].glm; ++i) {
-                for (int k = 0; k < globalGridLayout[procID].glp; ++k) {
+        for (int j = 0; j < layout.ghosts; ++j) {
+            for (int i = 0; i < layout.glm; ++i) {
+                for (int k = 0; k < layout.glp; ++k) {
 
                     PetscInt inds[dim]           = {i, j, k};
-                    Eigen::Vector3d coord = getLocalCoord(inds, procID);
+                    Eigen::Vector3d coord = getLocalCoord(inds, layout);
                     cellList.push_back(coord);
 
                 }
@@ -955,12 +1135,12 @@ std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > Grid<ty
     }
     if ( boundaries & 8 ) {
         // this means initialize the top side
-        for (int j = 0; j < globalGridLayout[procID].ghosts; ++j) {
-            for (int i = 0; i < globalGridLayout[procID].glm; ++i) {
-                for (int k = 0; k < globalGridLayout[procID].glp; ++k) {
+        for (int j = 0; j < layout.ghosts; ++j) {
+            for (int i = 0; i < layout.glm; ++i) {
+                for (int k = 0; k < layout.glp; ++k) {
 
-                    PetscInt inds[dim]           = {i, (globalGridLayout[procID].gln-1) - j, k};
-                    Eigen::Vector3d coord = getLocalCoord(inds, procID);
+                    PetscInt inds[dim]           = {i, (layout.gln-1) - j, k};
+                    Eigen::Vector3d coord = getLocalCoord(inds, layout);
                     cellList.push_back(coord);
 
                 }
@@ -969,12 +1149,12 @@ std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > Grid<ty
     }
     if ( boundaries & 16 ) {
         // this means initialize the front side
-        for (int k = 0; k < globalGridLayout[procID].ghosts; ++k) {
-            for (int i = 0; i < globalGridLayout[procID].glm; ++i) {
-                for (int j = 0; j < globalGridLayout[procID].gln; ++j) {
+        for (int k = 0; k < layout.ghosts; ++k) {
+            for (int i = 0; i < layout.glm; ++i) {
+                for (int j = 0; j < layout.gln; ++j) {
 
                     PetscInt inds[dim]   = {i, j, k};
-                    Eigen::Vector3d coord = getLocalCoord(inds, procID);
+                    Eigen::Vector3d coord = getLocalCoord(inds, layout);
                     cellList.push_back(coord);
 
 
@@ -985,12 +1165,12 @@ std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > Grid<ty
     }
     if ( boundaries & 32 ) {
         // this means initialize the far side
-        for (int k = 0; k < globalGridLayout[procID].ghosts; ++k) {
-            for (int i = 0; i < globalGridLayout[procID].glm; ++i) {
-                for (int j = 0; j < globalGridLayout[procID].gln; ++j) {
+        for (int k = 0; k < layout.ghosts; ++k) {
+            for (int i = 0; i < layout.glm; ++i) {
+                for (int j = 0; j < layout.gln; ++j) {
 
-                    PetscInt inds[dim]           = {i, j, (globalGridLayout[procID].glp-1) - k};
-                    Eigen::Vector3d coord = getLocalCoord(inds, procID);
+                    PetscInt inds[dim]           = {i, j, (layout.glp-1) - k};
+                    Eigen::Vector3d coord = getLocalCoord(inds, layout);
                     cellList.push_back(coord);
 
                 }
@@ -19,6 +19,11 @@
 #include "BoundingBox.hpp"
 #include "TriangleElement.hpp"
 #include "Geometry.hpp"
+#include "ClosestPointField.hpp"
+#include "WorkQueue.hpp"
+#include "ThreadPool.hpp"
+#include "StlStream.hpp"
+#include "SparseGrid.hpp"
 
 #include "tictoc.hpp"
 #include "utility.h"
@@ -36,7 +41,7 @@ void sdfMin(cDistance* in, cDistance* inout, int len, MPI_Datatype* dptr) {
 			if (in[i].pDistance > inout[i].pDistance) {
 				inout[i] = in[i];
 			}
-		} else if (ax > ay) {
+		} else if (ax < ay) {
 			inout[i] = in[i];
 		}
 	}
@@ -45,11 +50,32 @@ void sdfMin(cDistance* in, cDistance* inout, int len, MPI_Datatype* dptr) {
 
 class Initializer {
 public:
-	Initializer() {};
+	/// \param stealing band and boundary work of all ranks is shared, idle ranks steal it, see initBoundaries_lb
+	/// \param pool     threads of the rank for the band, the boundaries and the stolen items, NULL runs on the calling thread
+	Initializer(bool stealing = false, ThreadPool* pool = NULL) : stealing(stealing), pool(pool) {};
 
 	// This is where the magic happens and the initializator puts the data in
+	// when closest is given, closest triangle ID and point of every band cell is stored there too
 	template <typename type, int dim>
-	void operator() (Geometry& geom, Interface<type, dim>& interface, int groupID, int nGroups);
+	void operator() (Geometry& geom, Interface<type, dim>& interface, int groupID, int nGroups, ClosestPointField* closest = NULL);
+
+	/// Narrow band of a mesh which is never held whole, the far field is left to the parallel solver.
+	/// Every rank reads its part of the file in chunks, the triangles go to the ranks whose ghosted block
+	/// they touch, are put into the band there and dropped.
+	///
+	/// \param stl    part of the mesh read by this rank, scanned already
+	/// \param budget bytes of the triangles in flight on a rank, bounds the chunk of all ranks together
+	template <typename type, int dim>
+	void stream(StlStream& stl, Interface<type, dim>& interface, long int budget, int groupID, int nGroups, ClosestPointField* closest = NULL);
+
+	/// Narrow band of the sparse grid, only the leaves the band touches are allocated. The local elements
+	/// of the geometry have to be sorted by the node span of the grid table, the table nodes are set.
+	/// The threads compute the distances, the leaves are allocated on the calling thread.
+	void operator() (Geometry& geom, SparseGrid& grid);
+
+	/// Narrow band of the sparse grid from a mesh which is never held whole, as stream for the interface.
+	/// The triangles go to the ranks whose table they touch.
+	void stream(StlStream& stl, SparseGrid& grid, long int budget);
 
 
 private:
@@ -58,21 +84,79 @@ private:
 	MPI_Datatype mpi_cDist_type;
 	MPI_Op mpi_sdfmin;
 
+	bool        stealing;
+	ThreadPool* pool;
+
+	/// closest triangle found by a thread, stored into the field by the calling thread
+	struct ClosestUpdate {
+		long int cell;
+		long int triangle;
+		double   point[3];
+	};
+
+	static void applyClosest(const std::vector< std::vector<ClosestUpdate> >& updates, ClosestPointField* closest);
+
+	enum { bandWork = 0, boundaryWork = 1 };
+
+	/// work of initBoundaries_lb, triangles of the band or a brick of the boundary nodes
+	struct WorkItem {
+		int kind;         ///< bandWork or boundaryWork
+		int first, last;  ///< triangles [first, last) of the owner local elements
+		int lo[3], hi[3]; ///< nodes of the item, inclusive, the whole ghosted block for the band
+		int corner[3];    ///< first node of the ghosted block of the owner, the results are indexed in it
+		int size[3];      ///< nodes of the ghosted block of the owner
+	};
+
+	/// distance computed for the owner of the item
+	struct WorkResult {
+		long int cell;           ///< index of the node in the ghosted block of the owner, ghost nodes out of the domain have one too
+		long int item;           ///< index of the item at the owner
+		long int triangle;       ///< closest triangle ID
+		double   dist, sign, pd; ///< unsigned distance, sign and perpendicular distance, boundary has signed distance
+		double   point[3];       ///< closest point
+	};
+
+	static const int  trianglesPerItem = 32;
+	static const long cellsPerItem     = 1024;
+
+	/// merges the triangle distance into the band node, true when the node takes it
+	static bool mergeBand(double& data, double& perp, double dist, double sign, double pd);
+
 	void createTypes();
 	template <typename type, int dim>
 	void initAll(const Grid<type, dim>& gr, Geometry& geom, double*** data_ptr);
 	template <typename type, int dim>
-	void initBoundaries_nlb(const Grid<type, dim>& gr, Geometry& geom, double*** data_ptr, int boundaries);
+	void initBoundaries_nlb(const Grid<type, dim>& gr, Geometry& geom, double*** data_ptr, int boundaries, ClosestPointField* closest);
 	template <typename type, int dim>
-	void initBoundaries_lb(const Grid<type, dim>& gr, Geometry& geom, double*** data_ptr, int boundaries, int groupID, int nGroups);
+	void initBoundaries_lb(const Grid<type, dim>& gr, Geometry& geom, double*** data_ptr, double*** perpendicualDistance, int boundaries, ClosestPointField* closest);
+	template <typename type, int dim>
+	void reduceGroups(const Grid<type, dim>& gr, double*** data_ptr, double*** perpendicualDistance, int groupID, ClosestPointField* closest);
+	template <typename T>
+	static void allgatherColumn(const std::vector<T>& local, std::vector<T>& all, std::vector<int>& offsets, MPI_Comm column);
+	/// the threads share the item, the queue and the windows stay on the calling thread
+	template <typename type, int dim>
+	void processItem(const Grid<type, dim>& gr, Geometry& geom, const WorkItem& item, const std::vector<int>& triangles, int index, std::vector<WorkResult>& out);
 
 	int selectBoundaries(const Box<double, 3>& geometryAABB, const Box<double, 3>& procAABB);
 
+	double boundaryDistance(Geometry& geom, const Eigen::Vector3d& point, std::vector<ClosestUpdate>* updates, long int cell);
+
 	template <typename type, int dim>
 	void putDataToBoundaries(const Grid<type, dim>& gr, double*** data_ptr, cDistance* distanceData, int cellNum, int boundaries);
 
 	template <typename type, int dim>
-	void putLocalDataInside(const Grid<type, dim>& gr, double*** data_ptr, const std::vector<int>& localTriangles, const Geometry& geom, double*** perpendicualDistance);
+	void putLocalDataInside(const Grid<type, dim>& gr, double*** data_ptr, const std::vector<int>& localTriangles, const Geometry& geom, double*** perpendicualDistance, ClosestPointField* closest);
+
+	/// band of the triangles in the table of the sparse grid, perpendicualDistance follows the leaves
+	void putLocalDataInside(SparseGrid& grid, const std::vector<int>& localTriangles, const Geometry& geom, std::vector<double>& perpendicualDistance);
+
+	/// chunk of the streamed mesh read by a rank in one round, so budget holds, rounds are the same on all ranks
+	static long int streamChunk(const StlStream& stl, long int budget, long int& rounds);
+
+	/// every triangle read goes to the ranks owners(minX, maxX) returns for its aabb, the triangles sent
+	/// to this rank are returned as a small geometry with the IDs of the whole mesh
+	template <typename Owners>
+	static void sendTriangles(const std::vector<FlatGeometry::Triangle>& read, Owners owners, Geometry& part, std::vector<int>& triangles);
 
 };
 
@@ -101,17 +185,39 @@ void Initializer::createTypes() {
 	// end custom reduce operation commit
 }
 
-template <typename type, int dim>
-void Initializer::initAll(const Grid<type, dim>& gr, Geometry& geom, double*** data_ptr) {
+inline bool Initializer::mergeBand(double& data, double& perp, double dist, double sign, double pd) {
 
-	DM cda;
-	Vec gc;
-	DMDACoor3d ***coors;
+	double eps = my_eps;
 
-	DMGetCoordinatesLocal(gr.getDA() ,&gc);
-	DMGetCoordinateDM(gr.getDA(), &cda);
-	DMDAVecGetArray(cda, gc, &coors);
+	if ( dist < eps ) {
 
+		data = eps * sign;
+		perp = eps;
+		return true;
+
+	} else if ( fabs( dist - fabs(data) ) < eps ) {
+
+		// equal not funny
+		if ( perp <= pd ) {
+			data = sign * dist;
+			perp = pd;
+			return true;
+		}
+
+	} else if ( dist < fabs(data) ) {
+
+		// less so ok than
+		data = sign * dist;
+		perp = pd;
+		return true;
+	}
+
+	return false;
+
+}
+
+template <typename type, int dim>
+void Initializer::initAll(const Grid<type, dim>& gr, Geometry& geom, double*** data_ptr) {
 
 	int       x, y, z, m, n, p;
 	int       cellCounter = 0, gh = 1;
@@ -123,16 +229,12 @@ void Initializer::initAll(const Grid<type, dim>& gr, Geometry& geom, double*** d
 			for (int k = z; k < z+p; ++k) {
 				data_acc =
 						geom.computeDistance(
-							Eigen::Vector3d(coors[k][j][i].x,
-											coors[k][j][i].y,
-											coors[k][j][i].z),
+							gr.getCoord(i, j, k),
 							true
 						);
 
 				data_ref = geom.computeDistance(
-							Eigen::Vector3d(coors[k][j][i].x,
-											coors[k][j][i].y,
-											coors[k][j][i].z),
+							gr.getCoord(i, j, k),
 							false
 						);
 
@@ -143,323 +245,398 @@ void Initializer::initAll(const Grid<type, dim>& gr, Geometry& geom, double*** d
 }
 
 template <typename type, int dim>
-void Initializer::initBoundaries_nlb(const Grid<type, dim>& gr, Geometry& geom, double*** data_ptr, int boundaries) {
+void Initializer::initBoundaries_nlb(const Grid<type, dim>& gr, Geometry& geom, double*** data_ptr, int boundaries, ClosestPointField* closest) {
 
-	DM cda;
-	Vec gc;
-	DMDACoor3d ***coors;
+	int       x, y, z, m, n, p;
 
-	DMGetCoordinatesLocal(gr.getDA() ,&gc);
-	DMGetCoordinateDM(gr.getDA(), &cda);
-	DMDAVecGetArray(cda, gc, &coors);
+	DMDAGetGhostCorners(gr.getDA(), &x, &y, &z, &m, &n, &p);
 
+	std::vector< std::vector<ClosestUpdate> > updates(pool != NULL ? pool->size() : 1);
 
-	int       x, y, z, m, n, p;
-	int       cellCounter = 0, gh = 1;
+	for (int side = 0; side < 6; ++side) {
+		if ( !(boundaries & (1 << side)) )
+			continue;
 
-	DMDAGetGhostCorners(gr.getDA(), &x, &y, &z, &m, &n, &p);
+		// ordering : [left, right, bottom, top, front, back], one node thick face of the ghosted block
+		int lo[3] = {x, y, z}, hi[3] = {x+m-1, y+n-1, z+p-1};
+		const int axis = side / 2;
+		if ( side % 2 )
+			lo[axis] = hi[axis];
+		else
+			hi[axis] = lo[axis];
 
-	int tmpSum = 0;
-	if ( boundaries & 1 ) {
-		tmpSum+= gh*n*p;
-		// this means lets initialize left side
-		for (int i = x; i < x+gh; ++i) {
-			for (int j = y; j < y+n; ++j) {
-				for (int k = z; k < z+p; ++k) {
+		// the nodes are independent, threads take rows of the face
+		const int rowLength = hi[1] - lo[1] + 1;
+		const long int rows = long(rowLength) * (hi[2] - lo[2] + 1);
+
+		ThreadPool::parallelFor(pool, 0, rows, 16, [&](long int first, long int last, int thread) {
+			for (long int r = first; r < last; ++r) {
+				const int j = lo[1] + r % rowLength, k = lo[2] + r / rowLength;
+
+				for (int i = lo[0]; i <= hi[0]; ++i) {
 					data_ptr[k][j][i] =
-							geom.computeDistance(
-								Eigen::Vector3d(coors[k][j][i].x,
-												coors[k][j][i].y,
-												coors[k][j][i].z),
-								true
+							boundaryDistance(geom,
+								gr.getCoord(i, j, k),
+								closest != NULL ? &updates[thread] : NULL,
+								(i-x) + (j-y)*long(m) + (k-z)*long(m)*n
 							);
-					cellCounter++;
 				}
 			}
-		}
+		});
 	}
-	if ( boundaries & 2 ) {
-		tmpSum += gh*n*p;
-		// this means lets initialize right side
-		for (int i = x+m-1; i > x+m-1-gh; --i) {
-			for (int j = y; j < y+n; ++j) {
-				for (int k = z; k < z+p; ++k) {
-					data_ptr[k][j][i] =
-							geom.computeDistance(
-								Eigen::Vector3d(coors[k][j][i].x,
-												coors[k][j][i].y,
-												coors[k][j][i].z),
-								true
-							);
-					cellCounter++;
-				}
-			}
+
+	applyClosest(updates, closest);
+
+}
+
+template <typename type, int dim>
+void Initializer::initBoundaries_lb(const Grid<type, dim>& gr,
+		Geometry& geom,
+		double*** data_ptr,
+		double*** perpendicualDistance,
+		int boundaries,
+		ClosestPointField* closest) {
+
+	int x, y, z, m, n, p;
+	int myWorldRank, nProcsInWorld;
+
+	MPI_Comm_rank(PETSC_COMM_WORLD, &myWorldRank);
+	MPI_Comm_size(PETSC_COMM_WORLD, &nProcsInWorld);
+
+	DMDAGetGhostCorners(gr.getDA(), &x, &y, &z, &m, &n, &p);
+
+	const std::vector<int>& localTriangles = geom.localElements;
+
+	// step ONE queue own work, band items first so the boundary values overwrite the band ones
+	std::vector<WorkItem> items;
+
+	for (int first = 0; first < int(localTriangles.size()); first += trianglesPerItem) {
+		WorkItem item = { bandWork, first, std::min(first + trianglesPerItem, int(localTriangles.size())),
+		                  {x, y, z}, {x+m-1, y+n-1, z+p-1}, {x, y, z}, {m, n, p} };
+		items.push_back(item);
+	}
+
+	for (int side = 0; side < 6; ++side) {
+		if ( !(boundaries & (1 << side)) )
+			continue;
+
+		// ordering : [left, right, bottom, top, front, back], one node thick face of the ghosted block
+		WorkItem face = { boundaryWork, 0, 0, {x, y, z}, {x+m-1, y+n-1, z+p-1}, {x, y, z}, {m, n, p} };
+		const int axis = side / 2;
+		if ( side % 2 )
+			face.lo[axis] = face.hi[axis];
+		else
+			face.hi[axis] = face.lo[axis];
+
+		// cut the face along its longest direction into bricks of about cellsPerItem nodes
+		int  longest = 0;
+		long section = 1;
+		for (int d = 1; d < 3; ++d) {
+			if ( face.hi[d] - face.lo[d] > face.hi[longest] - face.lo[longest] )
+				longest = d;
+		}
+		for (int d = 0; d < 3; ++d) {
+			if ( d != longest )
+				section *= face.hi[d] - face.lo[d] + 1;
+		}
+		const int planes = std::max(1L, cellsPerItem / section);
+
+		for (int first = face.lo[longest]; first <= face.hi[longest]; first += planes) {
+			WorkItem brick = face;
+			brick.lo[longest] = first;
+			brick.hi[longest] = std::min(first + planes - 1, face.hi[longest]);
+			items.push_back(brick);
 		}
 	}
-	if ( boundaries & 4 ) {
-		tmpSum += gh*m*p;
-		// this means initialize the bottom side
-		for (int j = y; j < y+gh; ++j) {
-			for (int i = x; i < x+m; ++i) {
-				for (int k = z; k < z+p; ++k) {
-					data_ptr[k][j][i] =
-							geom.computeDistance(
-								Eigen::Vector3d(coors[k][j][i].x,
-												coors[k][j][i].y,
-												coors[k][j][i].z),
-								true
-							);
-					cellCounter++;
+
+	// step TWO process own and stolen items, thieves read the triangle lists of the owners
+	MPI_Win trianglesWin;
+	MPI_Win_create(const_cast<int*>(localTriangles.data()), MPI_Aint(localTriangles.size() * sizeof(int)), sizeof(int),
+	               MPI_INFO_NULL, PETSC_COMM_WORLD, &trianglesWin);
+	MPI_Win_lock_all(0, trianglesWin);
+
+	std::vector< std::vector<WorkResult> > results(nProcsInWorld);
+	{
+		WorkQueue<WorkItem> queue(items, PETSC_COMM_WORLD);
+
+		WorkItem         item;
+		int              owner, index;
+		std::vector<int> triangles;
+
+		while ( queue.next(item, owner, index) ) {
+			if ( item.kind == bandWork ) {
+				triangles.resize(item.last - item.first);
+				if ( owner == myWorldRank ) {
+					std::copy(localTriangles.begin() + item.first, localTriangles.begin() + item.last, triangles.begin());
+				} else {
+					MPI_Get(triangles.data(), triangles.size(), MPI_INT, owner, item.first, triangles.size(), MPI_INT, trianglesWin);
+					MPI_Win_flush(owner, trianglesWin);
 				}
 			}
+
+			processItem(gr, geom, item, triangles, index, results[owner]);
 		}
+	} // queue is freed together, nobody reads the triangles after
+
+	MPI_Win_unlock_all(trianglesWin);
+	MPI_Win_free(&trianglesWin);
+
+	// step THREE return the results to the owners
+	MPI_Datatype resultType;
+	MPI_Type_contiguous(sizeof(WorkResult), MPI_BYTE, &resultType);
+	MPI_Type_commit(&resultType);
+
+	std::vector<int> sendCounts(nProcsInWorld), recvCounts(nProcsInWorld), sendOffsets(nProcsInWorld + 1, 0), recvOffsets(nProcsInWorld + 1, 0);
+	for (int r = 0; r < nProcsInWorld; ++r) {
+		sendCounts[r]      = results[r].size();
+		sendOffsets[r + 1] = sendOffsets[r] + sendCounts[r];
 	}
-	if ( boundaries & 8 ) {
-		tmpSum += gh*m*p;
-		// this means initialize the top side
-		for (int j = y+n-1; j > y+n-1-gh; --j) {
-			for (int i = x; i < x+m; ++i) {
-				for (int k = z; k < z+p; ++k) {
-					data_ptr[k][j][i] =
-							geom.computeDistance(
-								Eigen::Vector3d(coors[k][j][i].x,
-												coors[k][j][i].y,
-												coors[k][j][i].z),
-								true
-							);
-					cellCounter++;
-				}
-			}
+	MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, PETSC_COMM_WORLD);
+	for (int r = 0; r < nProcsInWorld; ++r) {
+		recvOffsets[r + 1] = recvOffsets[r] + recvCounts[r];
+	}
+
+	std::vector<WorkResult> sendBuf(sendOffsets[nProcsInWorld]), recvBuf(recvOffsets[nProcsInWorld]);
+	for (int r = 0; r < nProcsInWorld; ++r) {
+		std::copy(results[r].begin(), results[r].end(), sendBuf.begin() + sendOffsets[r]);
+		std::vector<WorkResult>().swap(results[r]);
+	}
+	MPI_Alltoallv(sendBuf.data(), sendCounts.data(), sendOffsets.data(), resultType,
+	              recvBuf.data(), recvCounts.data(), recvOffsets.data(), resultType, PETSC_COMM_WORLD);
+
+	MPI_Type_free(&resultType);
+
+	// step FOUR put into the grid in the item order, the same order as without stealing
+	std::stable_sort(recvBuf.begin(), recvBuf.end(),
+	                 [](const WorkResult& a, const WorkResult& b) { return a.item < b.item; });
+
+	for (const WorkResult& r: recvBuf) {
+		const long int cell = r.cell;
+		const int      i    = x + cell % m, j = y + (cell / m) % n, k = z + cell / (long(m)*n);
+		bool           updated = true;
+
+		if ( items[r.item].kind == bandWork ) {
+			updated = mergeBand(data_ptr[k][j][i], perpendicualDistance[k][j][i], r.dist, r.sign, r.pd);
+		} else {
+			data_ptr[k][j][i] = r.dist;
+		}
+
+		if ( updated && closest != NULL ) {
+			closest->set(cell, r.triangle, Eigen::Vector3d(r.point[0], r.point[1], r.point[2]));
 		}
 	}
-	if ( boundaries & 16 ) {
-		tmpSum += gh*m*n;
-		// this means initialize the front side
-		for (int k = z; k < z+gh; ++k) {
-			for (int i = x; i < x+m; ++i) {
-				for (int j = y; j < y+n; ++j) {
-					data_ptr[k][j][i] =
-							geom.computeDistance(
-								Eigen::Vector3d(coors[k][j][i].x,
-												coors[k][j][i].y,
-												coors[k][j][i].z),
-								true
-							);
-					cellCounter++;
+
+}
+
+template <typename type, int dim>
+void Initializer::processItem(const Grid<type, dim>& gr, Geometry& geom, const WorkItem& item,
+		const std::vector<int>& triangles, int index, std::vector<WorkResult>& out) {
+
+	// nodes are indexed in the ghosted block of the owner, its ghosts out of the domain included
+	const long int m = item.size[0], mn = long(item.size[0]) * item.size[1];
+	const int*     c = item.corner;
+
+	if ( item.kind == boundaryWork ) {
+		// every node has its result, threads take rows of the brick and fill their places
+		const int      rowLength = item.hi[0] - item.lo[0] + 1, columnLength = item.hi[1] - item.lo[1] + 1;
+		const long int rows      = long(columnLength) * (item.hi[2] - item.lo[2] + 1);
+		const size_t   start     = out.size();
+
+		out.resize(start + rows * rowLength);
+
+		ThreadPool::parallelFor(pool, 0, rows, 4, [&](long int first, long int last, int) {
+			for (long int row = first; row < last; ++row) {
+				const int j = item.lo[1] + row % columnLength, k = item.lo[2] + row / columnLength;
+
+				for (int i = item.lo[0]; i <= item.hi[0]; ++i) {
+					long int        id;
+					Eigen::Vector3d closestPoint;
+					double          value = geom.computeDistance(gr.getCoord(i, j, k), true, id, closestPoint);
+
+					WorkResult r = { (i-c[0]) + (j-c[1])*m + (k-c[2])*mn, index, id, value, 1, 0,
+					                 {closestPoint[0], closestPoint[1], closestPoint[2]} };
+					out[start + row*rowLength + (i - item.lo[0])] = r;
 				}
 			}
-		}
+		});
+		return;
 	}
-	if ( boundaries & 32 ) {
-		tmpSum += gh*m*n;
-		// this means initialize the far side
-		for (int k = z+p-1; k > z+p-1-gh; --k) {
-			for (int i = x; i < x+m; ++i) {
-				for (int j = y; j < y+n; ++j) {
-					data_ptr[k][j][i] =
-							geom.computeDistance(
-								Eigen::Vector3d(coors[k][j][i].x,
-												coors[k][j][i].y,
-												coors[k][j][i].z),
-								true
-							);
-					cellCounter++;
+
+	// the same evaluation as putLocalDataInside, the merge is left on the owner
+	double narrowBand = gr.getDx(0) * 3;
+
+	// threads take the triangles, the results are appended in the triangle order
+	std::vector< std::vector<WorkResult> > perTriangle(triangles.size());
+
+	ThreadPool::parallelFor(pool, 0, triangles.size(), 1, [&](long int first, long int last, int) {
+		TriangleElement<double> element;
+
+		for (long int t = first; t < last; ++t) {
+			const TriangleElement<double>& currentElement = geom.getElement(triangles[t], element);
+
+			Box<int, 3> ind = gr.getGlobalBoxIndices( currentElement.getBoundingBox() );
+
+			auto bl = ind.bl();
+			auto tr = ind.tr();
+
+			for ( int k = std::max(bl[2], item.lo[2]); k <= std::min(tr[2], item.hi[2]); ++k ) {
+				for ( int j = std::max(bl[1], item.lo[1]); j <= std::min(tr[1], item.hi[1]); ++j ) {
+					for ( int i = std::max(bl[0], item.lo[0]); i <= std::min(tr[0], item.hi[0]); ++i ) {
+
+						Eigen::Vector3d        p  = gr.getCoord( Eigen::Vector3i(i,j,k) );
+						SignedDistance<double> v  = TriangleElement<double>::computeDistance(currentElement, p);
+						double                 pd = TriangleElement<double>::computePerpendicularDistance(currentElement, p);
+
+						if ( v.dist > narrowBand ) {
+							continue;
+						}
+
+						WorkResult r = { (i-c[0]) + (j-c[1])*m + (k-c[2])*mn, index, currentElement.ID, v.dist, double(v.sign), pd,
+						                 {v.minPoint[0], v.minPoint[1], v.minPoint[2]} };
+						perTriangle[t].push_back(r);
+					}
 				}
 			}
 		}
+	});
+
+	for (const std::vector<WorkResult>& part: perTriangle) {
+		out.insert(out.end(), part.begin(), part.end());
 	}
 
 }
 
-/* 
-template <typename type, int dim>
-void Initializer::initBoundaries_lb(const Grid<type, dim>& gr,
-		Geometry& geom,
-		double*** data_ptr,
-		int boundaries,
-		int groupID, int nGroups) {
 
-	tictoc tick;
-	int myWorldRank, nProcsInWorld;
-	int myBegin, myEnd;   // local indices start, local indices stop
-	int myBoundaries;
-	MPI_Comm_rank(MPI_COMM_WORLD, &myWorldRank);
-	MPI_Comm_size(MPI_COMM_WORLD, &nProcsInWorld);
-
-	tick.tic();
-	// prepare memory to store the list of all boundary cells
-	std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > boundaryCellList;
-	boundaryCellList.reserve( nProcsInWorld * 4 * gr.getM(0)*gr.getM(1) );
-
-	// this is where the results go (final results)
-	std::vector<cDistance> vDistance;
-	// create the fucking list
-	for (int p = 0; p < nProcsInWorld; ++p) {
-		// loop through the processes and get the proc bounding box
-		Box<double, 3> procBB    = gr.getNodeSpan(p);
-		int boundariesToInit     = selectBoundaries(geom.aabb, procBB);
-
-		std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > l =
-				gr.getNodeBoundaryCells(p, boundariesToInit);
-
-		// ok I need to remember what part of the boundary is mine, otherwise I am screwed
-		if (myWorldRank == p) {
-			myBegin      = boundaryCellList.size();
-			myEnd        = myBegin + l.size();
-			myBoundaries = boundariesToInit;
-		}
+template <typename T>
+void Initializer::allgatherColumn(const std::vector<T>& local, std::vector<T>& all, std::vector<int>& offsets, MPI_Comm column) {
 
-		boundaryCellList.insert( boundaryCellList.end(), l.begin(), l.end() );
-	}
+	int nGroups;
+	MPI_Comm_size(column, &nGroups);
 
-	tick.toc(myWorldRank, MAKECELLLIST, "Create boundary list");
+	// counted in bytes, the band of a block fits easily
+	int              count = local.size() * sizeof(T);
+	std::vector<int> counts(nGroups), displs(nGroups + 1, 0);
 
-	// number of cells in the boundary list for the WHOLE FUCKING BOUNDARY
-	int nBCells = boundaryCellList.size();
-	std::cout << "ncells: " << nBCells << std::endl;
-	tick.tic();
-	// loadbalance the problem.
-	// first create groups for the problem
-	MPI_Comm groupCommunicator = MPI_COMM_WORLD;
-	int nProcsInGroup;
-	int myGroupRank;
-	if ( nGroups > 1 ) {
-		// but if the number of groups is larger than one we need to create the right communicator.
-		// luckily the group assigment is already sorted in setup phase.
-		MPI_Comm_split(MPI_COMM_WORLD, groupID, myWorldRank, &groupCommunicator);
-	}
-	MPI_Comm_rank(groupCommunicator, &myGroupRank);
-	MPI_Comm_size(groupCommunicator, &nProcsInGroup);
-	// now each group will split its workload of boundary cells and start doing stuff
-
-	int numberOfCellsPerTask     = geom.getNumberOfCellsPerDomainLocal();
-	assert( numberOfCellsPerTask >= 0 );
-
-	int max_numberOfCellsPerTask = -std::numeric_limits<int>::max();
-	size_t totalCellsToFillTheGaps  = 0;
-	int exchangedNumberOfCellsPerTask[nProcsInGroup];
-
-	MPI_Allgather(&numberOfCellsPerTask, 1, MPI_INT, exchangedNumberOfCellsPerTask, nProcsInGroup, MPI_INT, groupCommunicator);
-
-	max_numberOfCellsPerTask = *std::max_element(exchangedNumberOfCellsPerTask, exchangedNumberOfCellsPerTask + nProcsInGroup);
-	assert( max_numberOfCellsPerTask >= 0 ); // maximum should not be negative
-
-	double diffs[nProcsInGroup];// diffs is the number of cells going to be added as balance for
-	for (int p = 0 ; p < nProcsInGroup; ++p) {
-		diffs[p] = max_numberOfCellsPerTask - exchangedNumberOfCellsPerTask[p];
-		assert( diffs[p] >= 0 );
-		totalCellsToFillTheGaps += size_t(max_numberOfCellsPerTask - exchangedNumberOfCellsPerTask[p]);
-		 if (myWorldRank == 0)
-			 std::cout << "DIFFS : " << (size_t)diffs[p] << "; MAX : " << max_numberOfCellsPerTask << "; EXCHANGED: " << exchangedNumberOfCellsPerTask[p] << std::endl;
-	}
-	if (myWorldRank == 0)
-		 std::cout << "SUM: " << totalCellsToFillTheGaps << std::endl;
-	size_t tmpSum = 0; double pSum = 0.0;
-	
-	if ( totalCellsToFillTheGaps > 0 ) {
-		for (int p = 0 ; p < nProcsInGroup; ++p) {
-			pSum += diffs[p]/double(totalCellsToFillTheGaps);
-			tmpSum += size_t(diffs[p]);
-
-			 if (myWorldRank == 0)
-				 std::cout << "PROC: " << p << " DIFF: " << double(diffs[p])  << " / " << double(totalCellsToFillTheGaps) << " - " << diffs[p]/double(totalCellsToFillTheGaps) << " - " << pSum
-				 << " - " << tmpSum << std::endl;
-			
-			diffs[p] = double(diffs[p]) / double(totalCellsToFillTheGaps);
-		}
-		 if (myWorldRank == 0)
-			 std::cout << "TMPSUM: " << tmpSum << std::endl;
-		assert( tmpSum == totalCellsToFillTheGaps ); // the percentage is not allowed to be greater then 100%
+	MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, column);
+	for (int g = 0; g < nGroups; ++g) {
+		displs[g + 1] = displs[g] + counts[g];
 	}
 
-	int theRest = nBCells - totalCellsToFillTheGaps;
-	if ( theRest < 0 ) {
-		// to make sure that assigment of negative shit is not happening
-		theRest                 = 0;
-		totalCellsToFillTheGaps = nBCells;
+	all.resize(displs[nGroups] / sizeof(T));
+	MPI_Allgatherv(local.data(), count, MPI_BYTE, all.data(), counts.data(), displs.data(), MPI_BYTE, column);
+
+	offsets.resize(nGroups + 1);
+	for (int g = 0; g <= nGroups; ++g) {
+		offsets[g] = displs[g] / sizeof(T);
 	}
-	
-	int start = 0, finish = 0;
-	int send_offsets[nProcsInGroup];
-	int send_lens[nProcsInGroup];
-	int debugSum = 0;
 
+}
 
-	for (int p = 0; p < nProcsInGroup; ++p) {
-		start  = finish;
+template <typename type, int dim>
+void Initializer::reduceGroups(const Grid<type, dim>& gr, double*** data_ptr, double*** perpendicualDistance, int groupID, ClosestPointField* closest) {
 
-		finish = (p == nProcsInGroup-1) ? nBCells : start + int( diffs[p]*double(totalCellsToFillTheGaps) ) + int( double(theRest)/double(nProcsInGroup) );
-		 
-		send_offsets[p] = start;
-		send_lens[p]    = finish - start;
-		debugSum += send_lens[p];
-	}
-	tick.toc(myWorldRank, SETUPGROUPS, "Setup groups");
-	assert( debugSum <= nBCells );
-	assert( send_lens[nProcsInGroup-1] + send_offsets[nProcsInGroup-1] == nBCells );	
+	int x, y, z, m, n, p;
+	int myGroupRank, nGroups;
 
+	DMDAGetGhostCorners(gr.getDA(), &x, &y, &z, &m, &n, &p);
+	MPI_Comm_rank(PETSC_COMM_WORLD, &myGroupRank);
 
-	tick.tic();
-	// std::cout << "send_offsets = " << send_offsets[myGroupRank] << ", send_lens = " << send_lens[myGroupRank] << ", nBCells = " << nBCells << std::endl;
-	assert( send_lens[myGroupRank] >= 0 );
-	assert( send_offsets[myGroupRank] >= 0 );
-	assert( (send_offsets[myGroupRank] + send_lens[myGroupRank]) <= nBCells );
-//	std::vector<cDistance> localDistances; localDistances.reserve( send_lens[myGroupRank] );
-	cDistance localDistances[ send_lens[myGroupRank] ];
-	// compute the distance within the group
+	// groups split the same grid the same way, the ranks of the same block are in one column
+	MPI_Comm column;
+	MPI_Comm_split(MPI_COMM_WORLD, myGroupRank, groupID, &column);
+	MPI_Comm_size(column, &nGroups);
 
+	const double far = std::numeric_limits<double>::max();
 
-	std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >::const_iterator begin_range = boundaryCellList.begin() + send_offsets[myGroupRank];
-	std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> >::const_iterator end_range = boundaryCellList.begin() + send_offsets[myGroupRank] + send_lens[myGroupRank];
-	std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > subList(begin_range, end_range);
-	std::cout << "allocated for locality check" << std::endl;
+	// step ONE compress, only the band and boundary cells as runs of the ghosted block
+	std::vector<int>       runs;    // start, length
+	std::vector<cDistance> values;
+	std::vector<long int>  ids;
+	std::vector<double>    points;
 
+	long int cell = 0;
+	for (int k = z; k < z+p; ++k) {
+		for (int j = y; j < y+n; ++j) {
+			for (int i = x; i < x+m; ++i, ++cell) {
+				if ( data_ptr[k][j][i] == far )
+					continue;
 
+				if ( runs.empty() || runs[runs.size() - 2] + runs.back() != cell ) {
+					runs.push_back(cell);
+					runs.push_back(0);
+				}
+				runs.back()++;
+
+				cDistance d = {data_ptr[k][j][i], perpendicualDistance[k][j][i]};
+				values.push_back(d);
+
+				if ( closest != NULL ) {
+					long int        id;
+					Eigen::Vector3d point = Eigen::Vector3d::Zero();
+					if ( !closest->get(cell, id, point) )
+						id = -1;
+					ids.push_back(id);
+					points.insert(points.end(), point.data(), point.data() + 3);
+				}
+			}
+		}
+	}
 
-	geom.computeDistance(subList, localDistances);
-	tick.toc(myWorldRank, COMPUTEDIST, "Compute bval dist");
+	// step TWO every group gets the band of the others
+	std::vector<int>       allRuns, runOffsets, valueOffsets, idOffsets, pointOffsets;
+	std::vector<cDistance> allValues;
+	std::vector<long int>  allIds;
+	std::vector<double>    allPoints;
+
+	allgatherColumn(runs, allRuns, runOffsets, column);
+	allgatherColumn(values, allValues, valueOffsets, column);
+	if ( closest != NULL ) {
+		allgatherColumn(ids, allIds, idOffsets, column);
+		allgatherColumn(points, allPoints, pointOffsets, column);
+		closest->clear();
+	}
 
-	boundaryCellList.clear();
-	
+	MPI_Comm_free(&column);
 
-	// put data together. That means call allgatherv and synchronize the shit.
+	// step THREE merge in the group order, so all groups end with the same values
+	for (int k = z; k < z+p; ++k) {
+		for (int j = y; j < y+n; ++j) {
+			for (int i = x; i < x+m; ++i) {
+				data_ptr[k][j][i]             =  far;
+				perpendicualDistance[k][j][i] = -far;
+			}
+		}
+	}
 
-	tick.tic();
-	assert( nBCells > 0 );
-	vDistance.resize( nBCells );
-	MPI_Allgatherv(&localDistances[0], send_lens[myGroupRank], mpi_cDist_type,  &vDistance[0], send_lens, send_offsets, mpi_cDist_type, groupCommunicator);
+	for (int g = 0; g < nGroups; ++g) {
+		long int v = valueOffsets[g];
 
-	tick.toc(myWorldRank, ALLGATHER, "Allgatherv vector");
-	// now the data is placed together in one nice vector
-	std::cout << "dumping vDistance: " << std::endl;
-	for (auto d: vDistance) {
-		std::cout << d.signedDistance << ", ";
-	} 
-	std::cout << std::endl;
+		for (int r = runOffsets[g]; r < runOffsets[g + 1]; r += 2) {
+			for (long int c = allRuns[r]; c < allRuns[r] + allRuns[r + 1]; ++c, ++v) {
+				const int i = x + c % m, j = y + (c / m) % n, k = z + c / (long(m) * n);
 
-	// synchronize the groups by reduce operation. This is only needed when you have more then one group
+				cDistance current = {data_ptr[k][j][i], perpendicualDistance[k][j][i]};
+				sdfMin(&allValues[v], &current, 1, NULL);
 
-	tick.tic();
-	if ( nGroups > 1 ) {
-//		mpi::all_reduce(world, &vDistance[0], nBCells, &vDistance[0], sdfMinimum<cDistance>());
-		MPI_Allreduce(&vDistance[0], &vDistance[0], nBCells, mpi_cDist_type, mpi_sdfmin, MPI_COMM_WORLD);
-	}
-	tick.toc(myWorldRank, REDUCE, "Reduce between groups");
+				if ( current.signedDistance == data_ptr[k][j][i] && current.pDistance == perpendicualDistance[k][j][i] )
+					continue;
 
-	tick.tic();
-	// step THREE put into the grid
-	assert( myBegin >= 0 );
-	assert( (myEnd-myBegin) < nBCells );
-	putDataToBoundaries(gr, data_ptr, &vDistance[myBegin], (myEnd-myBegin), myBoundaries);
+				data_ptr[k][j][i]             = current.signedDistance;
+				perpendicualDistance[k][j][i] = current.pDistance;
 
-	vDistance.clear();
-	tick.toc(myWorldRank, PUTTOBOUNDARIES, "Place to boundaries");
+				long int id = (closest != NULL) ? allIds[idOffsets[g] + v - valueOffsets[g]] : -1;
+				if ( id >= 0 ) {
+					const double* point = &allPoints[pointOffsets[g] + 3*(v - valueOffsets[g])];
+					closest->set(c, id, Eigen::Vector3d(point[0], point[1], point[2]));
+				}
+			}
+		}
+	}
 
 }
-*/
 
 template <typename type, int dim>
-void Initializer::operator ()(Geometry& geom, Interface<type, dim>& interface, int groupID, int nGroups) {
+void Initializer::operator ()(Geometry& geom, Interface<type, dim>& interface, int groupID, int nGroups, ClosestPointField* closest) {
 
 
 	std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d> > boundaryCells;    // xyz coordinated to compute the distance to
@@ -467,7 +644,7 @@ void Initializer::operator ()(Geometry& geom, Interface<type, dim>& interface, i
 	int                        myBoundaries;     // local boundaries to init
 
 	MPI_Group worldGroup;
-	MPI_Comm_group(MPI_COMM_WORLD, &worldGroup);
+	MPI_Comm_group(PETSC_COMM_WORLD, &worldGroup);
 	// perpendicular distance computed towards the triangle, it is used when we are no longer sure, which normal shall we use
 
 	double*** perpendicualDistance;
@@ -486,8 +663,8 @@ void Initializer::operator ()(Geometry& geom, Interface<type, dim>& interface, i
 	int myWorldRank;
 	int nProcsInWorld;
 
-	MPI_Comm_rank(MPI_COMM_WORLD, &myWorldRank);
-	MPI_Comm_size(MPI_COMM_WORLD, &nProcsInWorld);
+	MPI_Comm_rank(PETSC_COMM_WORLD, &myWorldRank);
+	MPI_Comm_size(PETSC_COMM_WORLD, &nProcsInWorld);
 
 
 	const Grid<type, dim>& gr = interface.getGrid();
@@ -509,47 +686,199 @@ void Initializer::operator ()(Geometry& geom, Interface<type, dim>& interface, i
 
 	// step FIVE compute triangle distance inside the narrowband
 
-	putLocalDataInside(gr, data_ptr, geom.localElements, geom, perpendicualDistance);
+	if ( closest != NULL )
+		closest->clear();
 
-	DMDARestoreArray(gr.getDA(), PETSC_TRUE, &perpendicualDistance);
+	if ( stealing && nProcsInWorld > 1 ) {
+		// band and boundaries together, the ranks without the surface help the others
+		int boundariesToInit = selectBoundaries(geom.aabb, gr.getNodeSpan(myWorldRank));
+		initBoundaries_lb(gr, geom, data_ptr, perpendicualDistance, boundariesToInit, closest);
+	} else {
+		putLocalDataInside(gr, data_ptr, geom.localElements, geom, perpendicualDistance, closest);
+
+		if ( nProcsInWorld > 1 ) {
+			int boundariesToInit = selectBoundaries(geom.aabb, gr.getNodeSpan(myWorldRank));
+			initBoundaries_nlb(gr, geom, data_ptr, boundariesToInit, closest);
+			// initAll(gr, geom, data_ptr);
+		}
+	}
 
 	// =====================================================================================================
 
-	if ( nProcsInWorld == 1 ) {
-//		DMDAGetGhostCorners(gr.getDA(), &x, &y, &z, &m, &n, &p);
-//		for (int k = z; k < z+p; ++k) {
-//			for (int j = y; j < y+n; ++j) {
-//		 		for (int i = x; i < x+m; ++i) {
-//		 			if ( data_ptr[k][j][i] >= 10E+5 )
-//		 				data_ptr[k][j][i] = -10;
-//				}
-//			}
-//		}
-		DMDAVecRestoreArray(gr.getDA(), localData, &data_ptr);
-		return;
+	if ( nGroups > 1 ) {
+		// every group saw only its part of the geometry, take the closest of them
+		reduceGroups(gr, data_ptr, perpendicualDistance, groupID, closest);
 	}
 
-	int boundariesToInit = selectBoundaries(geom.aabb, gr.getNodeSpan(myWorldRank));
-	initBoundaries_nlb(gr, geom, data_ptr, boundariesToInit);
-	// initAll(gr, geom, data_ptr);
+	DMDARestoreArray(gr.getDA(), PETSC_TRUE, &perpendicualDistance);
+	DMDAVecRestoreArray(gr.getDA(), localData, &data_ptr);
+
+}
 
-//=======================================================================================
-//	  DMDAGetGhostCorners(gr.getDA(), &x, &y, &z, &m, &n, &p);
-//	  for (int k = z; k < z+p; ++k) {
-//	  	for (int j = y; j < y+n; ++j) {
-//	  		for (int i = x; i < x+m; ++i) {
-//	  			if ( data_ptr[k][j][i] >= 10E+5 ) {
-//	  				data_ptr[k][j][i] = -10;
-//	  			}
-//	  		}
-//	  	}
-//	  }
-//=======================================================================================
 
+template <typename type, int dim>
+void Initializer::stream(StlStream& stl, Interface<type, dim>& interface, long int budget, int groupID, int nGroups, ClosestPointField* closest) {
+
+	typedef FlatGeometry::Triangle Triangle;
+
+	const Grid<type, dim>& gr        = interface.getGrid();
+	Vec                    localData = interface.getLocalData();
+	double***              data_ptr;
+	double***              perpendicualDistance;
+	int                    x, y, z, m, n, p;
+
+	DMDAVecGetArray(gr.getDA(), localData, &data_ptr);
+	DMDAGetArray(gr.getDA(), PETSC_TRUE, &perpendicualDistance);
+	DMDAGetGhostCorners(gr.getDA(), &x, &y, &z, &m, &n, &p);
+
+	for (int k = z; k < z+p; ++k) {
+		for (int j = y; j < y+n; ++j) {
+			for (int i = x; i < x+m; ++i) {
+				data_ptr[k][j][i]             =  std::numeric_limits<double>::max();
+				perpendicualDistance[k][j][i] = -std::numeric_limits<double>::max();
+			}
+		}
+	}
+
+	if ( closest != NULL )
+		closest->clear();
+
+	long int rounds;
+	long int chunk = streamChunk(stl, budget, rounds);
+
+	std::vector<Triangle> read;
+
+	stl.rewind();
+
+	for (long int round = 0; round < rounds; ++round) {
+		stl.read(chunk, read);
+
+		// every triangle to the ranks whose ghosted block its padded box touches, as putLocalDataInside clips it
+		Geometry         part;
+		std::vector<int> triangles;
+		sendTriangles(read, [&gr](const Box<double, 3>& box) {
+			return gr.getGhostedOwners( gr.getGlobalBoxIndices(box) );
+		}, part, triangles);
+
+		putLocalDataInside(gr, data_ptr, triangles, part, perpendicualDistance, closest);
+	}
+
+	if ( nGroups > 1 ) {
+		// every group read only its part of the file
+		reduceGroups(gr, data_ptr, perpendicualDistance, groupID, closest);
+	}
+
+	DMDARestoreArray(gr.getDA(), PETSC_TRUE, &perpendicualDistance);
 	DMDAVecRestoreArray(gr.getDA(), localData, &data_ptr);
 
 }
 
+inline long int Initializer::streamChunk(const StlStream& stl, long int budget, long int& rounds) {
+
+	typedef FlatGeometry::Triangle Triangle;
+
+	int nProcs;
+	MPI_Comm_size(PETSC_COMM_WORLD, &nProcs);
+
+	// a triangle is read, sent, received and held as element with its box, all chunks of a round
+	// may end on one rank
+	const long int bytesPerTriangle = 3 * sizeof(Triangle) + sizeof(TriangleElement<double>) + 3 * sizeof(Eigen::Vector3d) + sizeof(Box<PetscInt, 3>);
+	const long int chunk            = std::max(1L, budget / (bytesPerTriangle * nProcs));
+
+	rounds = (stl.size() + chunk - 1) / chunk;
+	MPI_Allreduce(MPI_IN_PLACE, &rounds, 1, MPI_LONG, MPI_MAX, PETSC_COMM_WORLD);
+
+	return chunk;
+
+}
+
+template <typename Owners>
+void Initializer::sendTriangles(const std::vector<FlatGeometry::Triangle>& read, Owners owners, Geometry& part, std::vector<int>& triangles) {
+
+	typedef FlatGeometry::Triangle Triangle;
+
+	int nProcs;
+	MPI_Comm_size(PETSC_COMM_WORLD, &nProcs);
+
+	std::vector<Triangle>                received;
+	std::vector< std::vector<Triangle> > bins(nProcs);
+	std::vector<int>                     sendCounts(nProcs), recvCounts(nProcs), sendOffsets(nProcs), recvOffsets(nProcs);
+
+	for (auto& triangle: read) {
+		double minX[3], maxX[3];
+		for (int d = 0; d < 3; ++d) {
+			minX[d] = std::min(triangle.vertices[0][d], std::min(triangle.vertices[1][d], triangle.vertices[2][d]));
+			maxX[d] = std::max(triangle.vertices[0][d], std::max(triangle.vertices[1][d], triangle.vertices[2][d]));
+		}
+
+		for (auto owner: owners( Box<double, 3>(minX, maxX) )) {
+			bins[owner].push_back(triangle);
+		}
+	}
+
+	std::vector<Triangle> send;
+	for (int r = 0; r < nProcs; ++r) {
+		sendOffsets[r] = send.size() * sizeof(Triangle);
+		sendCounts[r]  = bins[r].size() * sizeof(Triangle);
+		send.insert(send.end(), bins[r].begin(), bins[r].end());
+		std::vector<Triangle>().swap(bins[r]);
+	}
+
+	MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, PETSC_COMM_WORLD);
+
+	int total = 0;
+	for (int r = 0; r < nProcs; ++r) {
+		recvOffsets[r] = total;
+		total         += recvCounts[r];
+	}
+
+	received.resize(total / sizeof(Triangle));
+	MPI_Alltoallv(send.data(), sendCounts.data(), sendOffsets.data(), MPI_BYTE,
+	              received.data(), recvCounts.data(), recvOffsets.data(), MPI_BYTE, PETSC_COMM_WORLD);
+
+	// the chunk as a small geometry, its IDs are the ones of the whole mesh
+	triangles.resize(received.size());
+	for (size_t t = 0; t < received.size(); ++t) {
+		Eigen::Vector3d v0(received[t].vertices[0]), v1(received[t].vertices[1]), v2(received[t].vertices[2]);
+		part.appendElement( TriangleElement<double>(v0, v1, v2, received[t].ID) );
+		triangles[t] = t;
+	}
+
+}
+
+inline void Initializer::operator ()(Geometry& geom, SparseGrid& grid) {
+
+	std::vector<double> perpendicualDistance;
+
+	putLocalDataInside(grid, geom.localElements, geom, perpendicualDistance);
+
+}
+
+inline void Initializer::stream(StlStream& stl, SparseGrid& grid, long int budget) {
+
+	long int rounds;
+	long int chunk = streamChunk(stl, budget, rounds);
+
+	std::vector<FlatGeometry::Triangle> read;
+	std::vector<double>                 perpendicualDistance;
+
+	stl.rewind();
+
+	for (long int round = 0; round < rounds; ++round) {
+		stl.read(chunk, read);
+
+		// every triangle to the ranks whose table its padded box touches
+		Geometry         part;
+		std::vector<int> triangles;
+		sendTriangles(read, [&grid](const Box<double, 3>& box) {
+			return grid.getTableOwners( grid.getGlobalBoxIndices(box) );
+		}, part, triangles);
+
+		putLocalDataInside(grid, triangles, part, perpendicualDistance);
+	}
+
+}
+
 
 int Initializer::selectBoundaries(const Box<double, 3>& geometryAABB, const Box<double, 3>& procAABB) {
 	// chooses which boundaries of the domain have to be initialized
@@ -573,6 +902,36 @@ int Initializer::selectBoundaries(const Box<double, 3>& geometryAABB, const Box<
 }
 
 
+double Initializer::boundaryDistance(Geometry& geom, const Eigen::Vector3d& point, std::vector<ClosestUpdate>* updates, long int cell) {
+
+	if ( updates == NULL )
+		return geom.computeDistance(point, true);
+
+	long int        id;
+	Eigen::Vector3d closestPoint;
+	double          distance = geom.computeDistance(point, true, id, closestPoint);
+
+	ClosestUpdate update = { cell, id, {closestPoint[0], closestPoint[1], closestPoint[2]} };
+	updates->push_back(update);
+
+	return distance;
+
+}
+
+void Initializer::applyClosest(const std::vector< std::vector<ClosestUpdate> >& updates, ClosestPointField* closest) {
+
+	if ( closest == NULL )
+		return;
+
+	for (auto& thread: updates) {
+		for (auto& u: thread) {
+			closest->set(u.cell, u.triangle, Eigen::Vector3d(u.point[0], u.point[1], u.point[2]));
+		}
+	}
+
+}
+
+
 template <typename type, int dim>
 void Initializer::putDataToBoundaries(const Grid<type, dim>& gr, double*** data_ptr, cDistance* distanceData, int cellNum, int boundaries) {
 
@@ -660,11 +1019,10 @@ void Initializer::putDataToBoundaries(const Grid<type, dim>& gr, double*** data_
 }
 
 template <typename type, int dim>
-void Initializer::putLocalDataInside(const Grid<type, dim>& gr, double*** data_ptr, const std::vector<int>& localTriangles, const Geometry& geom, double*** perpendicualDistance) {
+void Initializer::putLocalDataInside(const Grid<type, dim>& gr, double*** data_ptr, const std::vector<int>& localTriangles, const Geometry& geom, double*** perpendicualDistance, ClosestPointField* closest) {
 	int       x, y, z, m, n, p;
 	double    narrowBand = gr.getDx(0) * 3;
 	double    minDX      = Eigen::Array3d(gr.getDx(0), gr.getDx(1), gr.getDx(2)).minCoeff();
-	double    eps        = my_eps;
 
 	DMDAGetGhostCorners(gr.getDA(), &x, &y, &z, &m, &n, &p);
 
@@ -677,70 +1035,153 @@ void Initializer::putLocalDataInside(const Grid<type, dim>& gr, double*** data_p
 	if ( localTriangles.size() == 0 )
 		return;
 
+	// threads own chunks of planes of the block, every node then sees the triangles
+	// in the same order as without the threads
+	const int planesPerChunk = (pool != NULL) ? std::max(1, p / (8 * pool->size())) : p;
+	const int nChunks        = (p + planesPerChunk - 1) / planesPerChunk;
+
+	std::vector< Box<int, 3> >      boxes;
+	std::vector< std::vector<int> > chunkTriangles(nChunks);
+
+	TriangleElement<double> element;
 
-	for (auto index: localTriangles) {
-		TriangleElement<double> currentElement = geom.getElement(index);
+	boxes.reserve( localTriangles.size() );
+	for (size_t t = 0; t < localTriangles.size(); ++t) {
+		boxes.push_back( gr.getGlobalBoxIndices( geom.getElement(localTriangles[t], element).getBoundingBox() ) );
 
-//		std::cout << currentElement << std::endl;
-//		std::cout << currentElement.getBoundingBox() << std::endl;
+		int kFirst = std::max(boxes[t].bl()[2], z), kLast = std::min(boxes[t].tr()[2], z+p-1);
+		for (int c = (kFirst - z) / planesPerChunk; kFirst <= kLast && c <= (kLast - z) / planesPerChunk; ++c) {
+			chunkTriangles[c].push_back(t);
+		}
+	}
 
-		Box<int, 3> ind = gr.getGlobalBoxIndices( currentElement.getBoundingBox() );
+	std::vector< std::vector<ClosestUpdate> > updates(pool != NULL ? pool->size() : 1);
 
-//		std::cout << ind << std::endl;
+	ThreadPool::parallelFor(pool, 0, nChunks, 1, [&](long int firstChunk, long int lastChunk, int thread) {
+		TriangleElement<double> threadElement;
 
+		for (long int c = firstChunk; c < lastChunk; ++c) {
+			const int kBegin = z + c * planesPerChunk, kEnd = std::min(kBegin + planesPerChunk, z+p);
 
-		auto bl = ind.bl();
-		auto tr = ind.tr();
+			for (auto t: chunkTriangles[c]) {
+				const TriangleElement<double>& currentElement = geom.getElement(localTriangles[t], threadElement);
 
-		for ( int k = bl[2]; k <= tr[2]; ++k ) {
+				auto bl = boxes[t].bl();
+				auto tr = boxes[t].tr();
 
-			if ( k < z || k >= (z+p) )
-				continue;
+				for ( int k = std::max(bl[2], kBegin); k <= tr[2] && k < kEnd; ++k ) {
 
-			for ( int j = bl[1]; j <= tr[1]; ++j ) {
+					for ( int j = bl[1]; j <= tr[1]; ++j ) {
 				
-				if ( j < y || j >= (y+n) )
-					continue;
+						if ( j < y || j >= (y+n) )
+							continue;
+
+						for ( int i = bl[0]; i <= tr[0]; ++i ) {
+
+							if ( i < x || i >= (x+m) ) 
+								continue;
 
-				for ( int i = bl[0]; i <= tr[0]; ++i ) {
+							Eigen::Vector3d        p       = gr.getCoord( Eigen::Vector3i(i,j,k) );
 
-					if ( i < x || i >= (x+m) ) 
-						continue;
+							SignedDistance<double> v       = TriangleElement<double>::computeDistance(currentElement, p);
+							double                 pd      = TriangleElement<double>::computePerpendicularDistance(currentElement, p);
 
-					Eigen::Vector3d        p       = gr.getCoord( Eigen::Vector3i(i,j,k) );
 
-					SignedDistance<double> v       = TriangleElement<double>::computeDistance(currentElement, p);
-					double                 pd      = TriangleElement<double>::computePerpendicularDistance(currentElement, p);
+							if ( v.dist > narrowBand ) {
+								continue;
+							}
 
+							bool updated = mergeBand(data_ptr[k][j][i], perpendicualDistance[k][j][i], v.dist, v.sign, pd);
 
-					if ( v.dist > narrowBand ) {
-						continue;
+							if ( updated && closest != NULL ) {
+								ClosestUpdate update = { (i-x) + (j-y)*long(m) + (k-z)*long(m)*n, currentElement.ID,
+								                         {v.minPoint[0], v.minPoint[1], v.minPoint[2]} };
+								updates[thread].push_back(update);
+							}
+
+						}
 					}
+				}
 
-					if ( v.dist < eps ) {
+			}
+		}
+	});
 
-						data_ptr[k][j][i]             = eps * v.sign;
-						perpendicualDistance[k][j][i] = eps;
+	applyClosest(updates, closest);
 
-					}  else if ( fabs( v.dist - fabs(data_ptr[k][j][i]) ) < eps ) {
+}
 
-						// equal not funny
-						if ( perpendicualDistance[k][j][i] <= pd ) {
-							data_ptr[k][j][i]             = v.sign * v.dist;
-							perpendicualDistance[k][j][i] = pd;
-						}
 
-					} else if ( v.dist < fabs(data_ptr[k][j][i]) ) {
+inline void Initializer::putLocalDataInside(SparseGrid& grid, const std::vector<int>& localTriangles, const Geometry& geom, std::vector<double>& perpendicualDistance) {
 
-						// less so ok than
-						data_ptr[k][j][i]             = v.sign * v.dist;
-						perpendicualDistance[k][j][i] = pd;
-					}
+	const int bs         = SparseGrid::brickSize;
+	double    narrowBand = grid.getDx(0) * 3;
+	int       lo[3], hi[3];
+	long int  first[3], last[3];
+
+	grid.getTableBricks(lo, hi);
+	for (int d = 0; d < 3; ++d) {
+		first[d] = long(lo[d]) * bs;
+		last[d]  = std::min(long(hi[d]) * bs, grid.getM(d)) - 1;
+	}
+
+	// threads evaluate blocks of triangles, the leaves are allocated and merged by the calling thread
+	// in the triangle order, activate is not thread safe and the band stays as without the threads
+	struct BandUpdate {
+		long int i, j, k;
+		double   dist, sign, pd;
+	};
+
+	const long int                         blockSize = 4096;
+	const long int                         nTriangles = localTriangles.size();
+	std::vector< std::vector<BandUpdate> > updates(std::min(blockSize, nTriangles));
+
+	for (long int firstTriangle = 0; firstTriangle < nTriangles; firstTriangle += blockSize) {
+		const long int lastTriangle = std::min(firstTriangle + blockSize, nTriangles);
+
+		ThreadPool::parallelFor(pool, firstTriangle, lastTriangle, 16, [&](long int from, long int to, int) {
+			TriangleElement<double> element;
+
+			for (long int t = from; t < to; ++t) {
+				const TriangleElement<double>& currentElement = geom.getElement(localTriangles[t], element);
+				std::vector<BandUpdate>&       out            = updates[t - firstTriangle];
+
+				Box<PetscInt, 3> box = grid.getGlobalBoxIndices( currentElement.getBoundingBox() );
+
+				out.clear();
+				for ( long int k = std::max(long(box.minX(2)), first[2]); k <= std::min(long(box.maxX(2)), last[2]); ++k ) {
+					for ( long int j = std::max(long(box.minX(1)), first[1]); j <= std::min(long(box.maxX(1)), last[1]); ++j ) {
+						for ( long int i = std::max(long(box.minX(0)), first[0]); i <= std::min(long(box.maxX(0)), last[0]); ++i ) {
 
+							Eigen::Vector3d        p = grid.getCoord(i, j, k);
+							SignedDistance<double> v = TriangleElement<double>::computeDistance(currentElement, p);
+
+							if ( v.dist > narrowBand ) {
+								continue;
+							}
+
+							BandUpdate u = { i, j, k, v.dist, double(v.sign),
+							                 TriangleElement<double>::computePerpendicularDistance(currentElement, p) };
+							out.push_back(u);
+
+						}
+					}
 				}
 			}
-		}
+		});
+
+		for (long int t = firstTriangle; t < lastTriangle; ++t) {
+			for (const BandUpdate& u: updates[t - firstTriangle]) {
+				// the leaf is allocated by the first triangle reaching it
+				int32_t  leaf = grid.activate( grid.getTableIndex(u.i / bs, u.j / bs, u.k / bs) );
+				long int cell = (u.i % bs) + bs * ( (u.j % bs) + bs * (u.k % bs) );
+
+				if ( long(perpendicualDistance.size()) < grid.getNumberOfLeaves() * SparseGrid::brickCells )
+					perpendicualDistance.resize(grid.getNumberOfLeaves() * SparseGrid::brickCells, -std::numeric_limits<double>::max());
 
+				mergeBand(grid.getLeaf(leaf)[cell], perpendicualDistance[long(leaf) * SparseGrid::brickCells + cell], u.dist, u.sign, u.pd);
+			}
+		}
 	}
 
 }
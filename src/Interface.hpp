@@ -9,6 +9,7 @@
 #define INTERFACE_H_
 
 #include "Grid.hpp"
+#include "FastMarching.hpp"
 #include <vector>
 #include <string>
 #include <petscdmadda.h>
@@ -18,6 +19,8 @@
 #include <petscviewer.h>
 #include <fstream>
 #include <cstdio>
+#include <cmath>
+#include <limits>
 
 namespace lsm {
 	#include "lsm_data_arrays.h"
@@ -45,10 +48,21 @@ public:
 	PetscReal* getArray();
 	void restoreArray(PetscReal* array);
 
+	/// copy of the owned block without the ghost layer, x fastest
+	void getOwnedData(std::vector<PetscReal>& owned) const;
 
+	/// replace the owned block by the data stored x fastest, the ghost layer is left as it is
+	void setOwnedData(const std::vector<PetscReal>& owned);
 
+	/// turn the current field back into signed distance, the zero level set is kept
+	/// and no geometry is needed
+	void redistance();
 
-	void writeData(char* file);
+
+	/// whole grid written by rank 0, through the output context kept by the grid
+	/// \param cached false builds and frees the scatter of the whole grid to every rank on each call,
+	///               as before the context, for comparing the time series output cost
+	void writeData(char* file, bool cached = true);
 
 	void saveForMatlab(char* file);
 
@@ -148,6 +162,170 @@ void Interface<type, dim>::restoreArray(PetscReal* array) {
 
 }
 
+template <typename type, int dim>
+void Interface<type, dim>::getOwnedData(std::vector<PetscReal>& owned) const {
+
+	const DMDALocalInfo* info = gr.getLocalInfo();
+	PetscReal*           arr;
+
+	int  lo[3]   = {info->xs - info->gxs, info->ys - info->gys, info->zs - info->gzs};
+	long strides = info->gxm;
+	long plane   = long(info->gxm) * info->gym;
+
+	owned.resize( long(info->xm) * info->ym * info->zm );
+
+	VecGetArray(localData, &arr);
+
+	// rows of the owned block are contiguous in the ghosted block
+	PetscReal* out = owned.data();
+	for (int k = lo[2]; k < lo[2] + info->zm; ++k) {
+		for (int j = lo[1]; j < lo[1] + info->ym; ++j) {
+			const PetscReal* row = arr + lo[0] + j*strides + k*plane;
+			out = std::copy(row, row + info->xm, out);
+		}
+	}
+
+	VecRestoreArray(localData, &arr);
+
+}
+
+template <typename type, int dim>
+void Interface<type, dim>::setOwnedData(const std::vector<PetscReal>& owned) {
+
+	const DMDALocalInfo* info = gr.getLocalInfo();
+	PetscReal*           arr;
+
+	int  lo[3]   = {info->xs - info->gxs, info->ys - info->gys, info->zs - info->gzs};
+	long strides = info->gxm;
+	long plane   = long(info->gxm) * info->gym;
+
+	VecGetArray(localData, &arr);
+
+	const PetscReal* in = owned.data();
+	for (int k = lo[2]; k < lo[2] + info->zm; ++k) {
+		for (int j = lo[1]; j < lo[1] + info->ym; ++j) {
+			std::copy(in, in + info->xm, arr + lo[0] + j*strides + k*plane);
+			in += info->xm;
+		}
+	}
+
+	VecRestoreArray(localData, &arr);
+
+}
+
+template <typename type, int dim>
+void Interface<type, dim>::redistance() {
+	// zero crossings of the field are located with subcell accuracy on the cells next to
+	// the interface, these seed the band and the rest is recomputed by fast marching
+
+	const DMDALocalInfo* info = gr.getLocalInfo();
+	DM                   da   = gr.getDA();
+
+	Vec        glob, seeds;
+	PetscReal* arr;
+	PetscReal* sd;
+
+	int    m[3] = {info->gxm, info->gym, info->gzm};
+	int    lo[3] = {info->xs - info->gxs, info->ys - info->gys, info->zs - info->gzs};
+	int    hi[3] = {lo[0] + info->xm,     lo[1] + info->ym,     lo[2] + info->zm};
+	long   strides[3] = {1, m[0], long(m[0])*m[1]};
+	double h[3];
+
+	// ghosts out of the domain are never filled by the scatter, local indices of the domain are [first, last)
+	int first[3] = {std::max(0, -int(info->gxs)), std::max(0, -int(info->gys)), std::max(0, -int(info->gzs))};
+	int last[3]  = {std::min(m[0], int(info->mx - info->gxs)),
+	                std::min(m[1], int(info->my - info->gys)),
+	                std::min(m[2], int(info->mz - info->gzs))};
+
+	for (int d = 0; d < 3; ++d)
+		h[d] = gr.getDx(d);
+
+	DMGetGlobalVector(da, &glob);
+	DMGetLocalVector(da, &seeds);
+
+	// the ghost layer has to hold the owners values, otherwise crossings are missed
+	DMLocalToGlobalBegin(da, localData, INSERT_VALUES, glob);
+	DMLocalToGlobalEnd(da, localData, INSERT_VALUES, glob);
+	DMGlobalToLocalBegin(da, glob, INSERT_VALUES, localData);
+	DMGlobalToLocalEnd(da, glob, INSERT_VALUES, localData);
+
+	VecSet(seeds, std::numeric_limits<double>::max());
+
+	VecGetArray(localData, &arr);
+	VecGetArray(seeds, &sd);
+
+	// only owned cells are seeded, they see all their neighbors
+	for (int k = lo[2]; k < hi[2]; ++k) {
+		for (int j = lo[1]; j < hi[1]; ++j) {
+			for (int i = lo[0]; i < hi[0]; ++i) {
+				int  ind[3] = {i, j, k};
+				long c      = i + j*strides[1] + k*strides[2];
+				double phi  = arr[c];
+
+				if ( phi == 0 ) {
+					sd[c] = 0;
+					continue;
+				}
+
+				// distance to the crossing along each axis, linear interpolation
+				double invSq   = 0;
+				bool   crossed = false;
+				for (int d = 0; d < 3; ++d) {
+					double axisDist = std::numeric_limits<double>::max();
+
+					for (int dir = -1; dir <= 1; dir += 2) {
+						if ( ind[d] + dir < first[d] || ind[d] + dir >= last[d] )
+							continue;
+
+						double nb = arr[c + dir*strides[d]];
+						if ( (phi < 0) != (nb < 0) ) {
+							double theta = phi / (phi - nb);
+							axisDist = std::min(axisDist, theta * h[d]);
+						}
+					}
+
+					if ( axisDist < std::numeric_limits<double>::max() ) {
+						invSq  += 1.0 / (axisDist*axisDist);
+						crossed = true;
+					}
+				}
+
+				if ( crossed ) {
+					sd[c] = (phi < 0 ? -1.0 : 1.0) / std::sqrt(invSq);
+				}
+			}
+		}
+	}
+
+	VecRestoreArray(seeds, &sd);
+	VecRestoreArray(localData, &arr);
+
+	// ghosts get the seeds of their owners, the field itself is replaced by the seeds
+	DMLocalToGlobalBegin(da, seeds, INSERT_VALUES, glob);
+	DMLocalToGlobalEnd(da, seeds, INSERT_VALUES, glob);
+	DMGlobalToLocalBegin(da, glob, INSERT_VALUES, localData);
+	DMGlobalToLocalEnd(da, glob, INSERT_VALUES, localData);
+
+	// the old field left in the ghosts out of the domain would be taken for the band
+	VecGetArray(localData, &arr);
+	for (int k = 0; k < m[2]; ++k) {
+		for (int j = 0; j < m[1]; ++j) {
+			bool outside = k < first[2] || k >= last[2] || j < first[1] || j >= last[1];
+			for (int i = 0; i < m[0]; ++i) {
+				if ( outside || i < first[0] || i >= last[0] )
+					arr[i + j*strides[1] + k*strides[2]] = std::numeric_limits<double>::max();
+			}
+		}
+	}
+	VecRestoreArray(localData, &arr);
+
+	DMRestoreLocalVector(da, &seeds);
+	DMRestoreGlobalVector(da, &glob);
+
+	FastMarching<double>::solveEikonalEquationParallel<dim>(gr, localData);
+
+}
+
 //template <typename type, int dim> template <typename DataProvider>
 //void Interface<type, dim>::initialize(Initializer<DataProvider, dim>* init) {
 //	// loop thourg the data and initialize it
@@ -189,30 +367,48 @@ void Interface<type, dim>::dumpData() {
 }
 
 template <typename type, int dim>
-void Interface<type, dim>::writeData(char* file) {
+void Interface<type, dim>::writeData(char* file, bool cached) {
 
 	int rank;
 	const DMDALocalInfo* info = gr.getLocalInfo();
 
 
-	long int length = gr.getM(0) * gr.getM(1) * gr.getM(2);
+	long int length = long(gr.getM(0)) * gr.getM(1) * gr.getM(2);
+
 
+	// natural ordered values of the whole grid, on rank 0 at least
+	Vec        root;
+	Vec        glob = NULL, seq = NULL;
+	VecScatter tolocalall = NULL;
 
-	Vec        glob, seq;
-	VecScatter tolocalall, fromlocalall, sc;
+	if (cached) {
+		GridOutputContext& out = gr.getOutputContext();
 
-	DMCreateGlobalVector(info->da, &glob);
+		DMLocalToGlobalBegin(info->da, localData, INSERT_VALUES, out.global);
+		DMLocalToGlobalEnd(info->da, localData, INSERT_VALUES, out.global);
 
+		DMDAGlobalToNaturalBegin(info->da, out.global, INSERT_VALUES, out.natural);
+		DMDAGlobalToNaturalEnd(info->da, out.global, INSERT_VALUES, out.natural);
 
-	DMDAGlobalToNaturalAllCreate(info->da, &tolocalall);
+		VecScatterBegin(out.toRoot, out.natural, out.root, INSERT_VALUES, SCATTER_FORWARD);
+		VecScatterEnd(out.toRoot, out.natural, out.root, INSERT_VALUES, SCATTER_FORWARD);
 
-	DMLocalToGlobalBegin(info->da, localData, INSERT_VALUES, glob);
-	DMLocalToGlobalEnd(info->da, localData, INSERT_VALUES, glob);
+		root = out.root;
+	} else {
+		DMCreateGlobalVector(info->da, &glob);
 
-	VecCreateSeq(PETSC_COMM_SELF, length, &seq);
+		DMDAGlobalToNaturalAllCreate(info->da, &tolocalall);
 
-	VecScatterBegin(tolocalall, glob, seq, INSERT_VALUES, SCATTER_FORWARD);
-	VecScatterEnd(tolocalall, glob, seq, INSERT_VALUES, SCATTER_FORWARD);
+		DMLocalToGlobalBegin(info->da, localData, INSERT_VALUES, glob);
+		DMLocalToGlobalEnd(info->da, localData, INSERT_VALUES, glob);
+
+		VecCreateSeq(PETSC_COMM_SELF, length, &seq);
+
+		VecScatterBegin(tolocalall, glob, seq, INSERT_VALUES, SCATTER_FORWARD);
+		VecScatterEnd(tolocalall, glob, seq, INSERT_VALUES, SCATTER_FORWARD);
+
+		root = seq;
+	}
 
 
 	MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
@@ -234,7 +430,7 @@ void Interface<type, dim>::writeData(char* file) {
 		fp = fopen(file, "w");
 
 		double * data;
-		VecGetArray(seq, &data);
+		VecGetArray(root, &data);
 
 		fwrite(&d, sizeof(int), 1, fp);
 		fwrite(dims, sizeof(int), 3, fp);
@@ -246,10 +442,16 @@ void Interface<type, dim>::writeData(char* file) {
 		fclose(fp);
 
 
-		VecRestoreArray(seq, &data);
+		VecRestoreArray(root, &data);
 
 	}
 
+	if (!cached) {
+		VecScatterDestroy(&tolocalall);
+		VecDestroy(&seq);
+		VecDestroy(&glob);
+	}
+
 }
 
 
@@ -262,15 +464,12 @@ const Grid<type, dim>& Interface<type, dim>::getGrid() const {
 template <typename type, int dim>
 void Interface<type, dim>::saveForMatlab(char* file) {
 
-	PetscErrorCode ierr;
-	PetscViewer    view;
-	DMDALocalInfo* info;
-
-	info = gr->getLocalInfo();
-
-	int size;
+	PetscErrorCode       ierr;
+	PetscViewer          view;
+	const DMDALocalInfo* info = gr.getLocalInfo();
+	Vec                  globalData = gr.getOutputContext().global;
 
-	ierr = DMCreateGlobalVector(info->da, &globalData);
+	PetscInt size;
 
 	ierr = DMLocalToGlobalBegin(info->da, localData, INSERT_VALUES, globalData);
 
@@ -300,25 +499,43 @@ void Interface<type, dim>::saveForMatlab(char* file) {
 template <typename type, int dim>
 void Interface<type, dim>::saveForParaView(char* file) {
 
-	PetscErrorCode ierr;
-	PetscViewer    view;
-	DMDALocalInfo* info;
+	// legacy ascii VTK written on rank 0, the DMDA has no coordinates so origin and spacing are written here
+	int                  rank;
+	const DMDALocalInfo* info = gr.getLocalInfo();
+	GridOutputContext&   out  = gr.getOutputContext();
 
-	info = gr->getLocalInfo();
+	long int length = long(gr.getM(0)) * gr.getM(1) * gr.getM(2);
 
-	ierr = DMCreateGlobalVector(info->da, &globalData);
+	DMLocalToGlobalBegin(info->da, localData, INSERT_VALUES, out.global);
+	DMLocalToGlobalEnd(info->da, localData, INSERT_VALUES, out.global);
 
-	ierr = DMLocalToGlobalBegin(info->da, localData, INSERT_VALUES, globalData);
-	ierr = DMLocalToGlobalEnd(info->da, localData, INSERT_VALUES, globalData);
+	DMDAGlobalToNaturalBegin(info->da, out.global, INSERT_VALUES, out.natural);
+	DMDAGlobalToNaturalEnd(info->da, out.global, INSERT_VALUES, out.natural);
 
-	ierr = PetscViewerCreate(PETSC_COMM_WORLD, &view);
-	ierr = PetscViewerSetType(view, PETSCVIEWERASCII);
-	ierr = PetscViewerFileSetName(view, file);
-	ierr = PetscViewerSetFormat(view, PETSC_VIEWER_ASCII_VTK);
-	ierr = PetscObjectSetName((PetscObject)globalData, "phi");
-	ierr = DMView(info->da, view);
-	ierr = VecView(globalData, view);
-	ierr = PetscViewerDestroy(&view);
+	VecScatterBegin(out.toRoot, out.natural, out.root, INSERT_VALUES, SCATTER_FORWARD);
+	VecScatterEnd(out.toRoot, out.natural, out.root, INSERT_VALUES, SCATTER_FORWARD);
+
+	MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+
+	if (rank == 0) {
+		FILE*   fp = fopen(file, "w");
+		double* data;
+
+		VecGetArray(out.root, &data);
+
+		fprintf(fp, "# vtk DataFile Version 2.0\nphi\nASCII\nDATASET STRUCTURED_POINTS\n");
+		fprintf(fp, "DIMENSIONS %d %d %d\n", int(gr.getM(0)), int(gr.getM(1)), int(gr.getM(2)));
+		fprintf(fp, "ORIGIN %.17g %.17g %.17g\n", gr.getMin(0), gr.getMin(1), gr.getMin(2));
+		fprintf(fp, "SPACING %.17g %.17g %.17g\n", gr.getDx(0), gr.getDx(1), gr.getDx(2));
+		fprintf(fp, "POINT_DATA %ld\nSCALARS phi double 1\nLOOKUP_TABLE default\n", length);
+		for (long int c = 0; c < length; ++c) {
+			fprintf(fp, "%.17g\n", data[c]);
+		}
+
+		fclose(fp);
+
+		VecRestoreArray(out.root, &data);
+	}
 
 }
 /*
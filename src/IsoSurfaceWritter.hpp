@@ -0,0 +1,381 @@
+/*
+ * IsoSurfaceWritter.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef ISOSURFACEWRITTER_HPP_
+#define ISOSURFACEWRITTER_HPP_
+
+#include <petscdmda.h>
+#include <petscsys.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <Eigen/Dense>
+
+#include "Grid.hpp"
+#include "Interface.hpp"
+
+
+/// grid edges used by the tetrahedra, as offsets of the upper node
+static const int isoEdgeDirs[7][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1},
+                                      {1, 1, 0}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1}};
+
+/// corners of the six tetrahedra around the main diagonal of the cube,
+/// cube corner c is at (c&1, (c>>1)&1, (c>>2)&1)
+static const int isoTets[6][4] = {{0, 1, 3, 7}, {0, 1, 5, 7}, {0, 2, 3, 7},
+                                  {0, 2, 6, 7}, {0, 4, 5, 7}, {0, 4, 6, 7}};
+
+/// output format of IsoSurfaceWritter
+enum IsoSurfaceFormat {
+	ISO_PLY = 0, ///< binary PLY, vertices shared by the triangles
+	ISO_STL = 1  ///< binary STL, three vertices per triangle
+};
+
+
+/// \brief Extracts the isosurface of the interface and writes it as one binary PLY or STL file.
+///
+/// Every rank triangulates the cubes of its owned block by marching tetrahedra, each cube is split
+/// into six tetrahedra around its main diagonal, so the triangulation has no ambiguous cases and
+/// neighboring cubes match. Vertices lie on grid edges, the edge is owned by the rank owning its
+/// lower node. Ranks number their own vertices, ids of the vertices owned by the neighbors are
+/// exchanged once, so the PLY has every vertex exactly once. All ranks then write their vertices
+/// and triangles at once with collective MPI-IO, the file grows with the surface, not the volume.
+class IsoSurfaceWritter {
+
+	static const MPI_Offset plyVertexSize = 3*sizeof(float);
+	static const MPI_Offset plyFaceSize   = 1 + 3*sizeof(int32_t);
+	static const MPI_Offset stlFaceSize   = 50;
+
+	/// triangles and vertices found by this rank
+	struct Surface {
+		std::vector<float>     points;    ///< owned vertices, x y z
+		std::vector<long long> triangles; ///< edge keys, three per triangle
+		std::vector<float>     corners;   ///< positions of the triangle corners, for STL
+		std::unordered_map<long long, long int> owned; ///< edge key -> index of owned vertex
+	};
+
+	/// the surface point on the edge from node a to node b
+	static Eigen::Vector3d crossing(const Eigen::Vector3d& pa, double a, const Eigen::Vector3d& pb, double b, double iso) {
+		double t = (iso - a) / (b - a);
+		return pa + t * (pb - pa);
+	}
+
+	static const char* plyByteOrder();
+
+public:
+
+	/// \param iso    value of the isosurface
+	/// \param format ISO_PLY or ISO_STL, the suffix .ply or .stl is added to the file name
+	template <typename type, int dim>
+	static void writeData(const Interface<type, dim>& data, char* file, double iso = 0, int format = ISO_PLY);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+inline const char* IsoSurfaceWritter::plyByteOrder() {
+
+	const uint16_t one = 1;
+
+	return ( *(const char*)&one == 1 ) ? "binary_little_endian" : "binary_big_endian";
+
+}
+
+template <typename type, int dim>
+void IsoSurfaceWritter::writeData(const Interface<type, dim>& data, char* file, double iso, int format) {
+
+	int rank, nRanks;
+	const Grid<type, dim>& gr   = data.getGrid();
+	const DMDALocalInfo*   info = gr.getLocalInfo();
+	DM                     da   = gr.getDA();
+
+	MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+	MPI_Comm_size(PETSC_COMM_WORLD, &nRanks);
+
+	const long int mx = info->mx, my = info->my, mz = info->mz;
+
+	// cubes and edges reach one node above the owned block, its owners have to refresh it first
+	Vec        glob, ghosted;
+	PetscReal* arr;
+
+	DMGetGlobalVector(da, &glob);
+	DMGetLocalVector(da, &ghosted);
+	DMLocalToGlobalBegin(da, data.getLocalData(), INSERT_VALUES, glob);
+	DMLocalToGlobalEnd(da, data.getLocalData(), INSERT_VALUES, glob);
+	DMGlobalToLocalBegin(da, glob, INSERT_VALUES, ghosted);
+	DMGlobalToLocalEnd(da, glob, INSERT_VALUES, ghosted);
+	VecGetArray(ghosted, &arr);
+
+	const long int gxm = info->gxm, gym = info->gym;
+
+	#define ISO_VALUE(i, j, k) arr[ ((i) - info->gxs) + ((j) - info->gys)*gxm + ((k) - info->gzs)*gxm*gym ]
+
+	Surface surf;
+
+	// owned vertices, on the crossed edges going up from the owned nodes
+	for (int k = info->zs; k < info->zs + info->zm; ++k) {
+		for (int j = info->ys; j < info->ys + info->ym; ++j) {
+			for (int i = info->xs; i < info->xs + info->xm; ++i) {
+				double a = ISO_VALUE(i, j, k);
+				for (int d = 0; d < 7; ++d) {
+					int u = i + isoEdgeDirs[d][0], v = j + isoEdgeDirs[d][1], w = k + isoEdgeDirs[d][2];
+					if ( u >= mx || v >= my || w >= mz )
+						continue;
+
+					double b = ISO_VALUE(u, v, w);
+					if ( (a < iso) == (b < iso) )
+						continue;
+
+					Eigen::Vector3d p = crossing(gr.getCoord(Eigen::Vector3i(i, j, k)), a, gr.getCoord(Eigen::Vector3i(u, v, w)), b, iso);
+
+					long long key = (i + j*mx + k*mx*my) * 7LL + d;
+					surf.owned[key] = surf.points.size() / 3;
+					surf.points.push_back(p[0]);
+					surf.points.push_back(p[1]);
+					surf.points.push_back(p[2]);
+				}
+			}
+		}
+	}
+
+	// triangles of the owned cubes
+	for (int k = info->zs; k < std::min(long(info->zs + info->zm), mz - 1); ++k) {
+		for (int j = info->ys; j < std::min(long(info->ys + info->ym), my - 1); ++j) {
+			for (int i = info->xs; i < std::min(long(info->xs + info->xm), mx - 1); ++i) {
+				int             node[8][3];
+				double          val[8];
+				Eigen::Vector3d pos[8];
+				int             mask = 0;
+				for (int c = 0; c < 8; ++c) {
+					node[c][0] = i + (c & 1);
+					node[c][1] = j + ((c >> 1) & 1);
+					node[c][2] = k + ((c >> 2) & 1);
+					val[c]     = ISO_VALUE(node[c][0], node[c][1], node[c][2]);
+					pos[c]     = gr.getCoord(Eigen::Vector3i(node[c][0], node[c][1], node[c][2]));
+					mask      |= (val[c] < iso) << c;
+				}
+				if ( mask == 0 || mask == 255 )
+					continue;
+
+				for (int t = 0; t < 6; ++t) {
+					int in[4], out[4], nIn = 0, nOut = 0;
+					for (int c = 0; c < 4; ++c) {
+						if ( val[isoTets[t][c]] < iso ) in[nIn++]   = isoTets[t][c];
+						else                              out[nOut++] = isoTets[t][c];
+					}
+					if ( nIn == 0 || nOut == 0 )
+						continue;
+
+					// crossed edges forming a triangle or a quad, quad edges go around it
+					int edges[4][2], nEdges;
+					if ( nIn == 1 || nOut == 1 ) {
+						int  single = (nIn == 1) ? in[0] : out[0];
+						int* other  = (nIn == 1) ? out : in;
+						for (int e = 0; e < 3; ++e) {
+							edges[e][0] = single; edges[e][1] = other[e];
+						}
+						nEdges = 3;
+					} else {
+						edges[0][0] = in[0]; edges[0][1] = out[0];
+						edges[1][0] = in[0]; edges[1][1] = out[1];
+						edges[2][0] = in[1]; edges[2][1] = out[1];
+						edges[3][0] = in[1]; edges[3][1] = out[0];
+						nEdges = 4;
+					}
+
+					long long       keys[4];
+					Eigen::Vector3d pts[4];
+					Eigen::Vector3d toOutside(0, 0, 0);
+					for (int e = 0; e < nEdges; ++e) {
+						int lo = edges[e][0], hi = edges[e][1];
+						// corners of a tetrahedron are ordered along every axis, lower one is the base
+						if ( (lo & hi) != lo ) std::swap(lo, hi);
+
+						int dir = 0;
+						for (int d = 0; d < 7; ++d) {
+							if ( isoEdgeDirs[d][0] == ((hi & 1) - (lo & 1)) && isoEdgeDirs[d][1] == (((hi >> 1) & 1) - ((lo >> 1) & 1))
+									&& isoEdgeDirs[d][2] == (((hi >> 2) & 1) - ((lo >> 2) & 1)) )
+								dir = d;
+						}
+
+						keys[e] = (node[lo][0] + node[lo][1]*mx + node[lo][2]*mx*my) * 7LL + dir;
+						pts[e]  = crossing(pos[lo], val[lo], pos[hi], val[hi], iso);
+					}
+					for (int c = 0; c < nOut; ++c) toOutside += pos[out[c]] / nOut;
+					for (int c = 0; c < nIn; ++c)  toOutside -= pos[in[c]] / nIn;
+
+					// the quad is split along its first diagonal, normals point to the values above iso
+					const int split[2][3] = {{0, 1, 2}, {0, 2, 3}};
+					for (int s = 0; s < nEdges - 2; ++s) {
+						int a = split[s][0], b = split[s][1], c = split[s][2];
+						if ( (pts[b] - pts[a]).cross(pts[c] - pts[a]).dot(toOutside) < 0 )
+							std::swap(b, c);
+
+						const int corner[3] = {a, b, c};
+						for (int v = 0; v < 3; ++v) {
+							surf.triangles.push_back(keys[corner[v]]);
+							if ( format == ISO_STL ) {
+								surf.corners.push_back(pts[corner[v]][0]);
+								surf.corners.push_back(pts[corner[v]][1]);
+								surf.corners.push_back(pts[corner[v]][2]);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	#undef ISO_VALUE
+
+	VecRestoreArray(ghosted, &arr);
+	DMRestoreLocalVector(da, &ghosted);
+	DMRestoreGlobalVector(da, &glob);
+
+	long long nTriangles = surf.triangles.size() / 3;
+	long long nVertices  = surf.points.size() / 3;
+	long long triangleStart = 0, vertexStart = 0, allTriangles = 0, allVertices = 0;
+
+	MPI_Exscan(&nTriangles, &triangleStart, 1, MPI_LONG_LONG, MPI_SUM, PETSC_COMM_WORLD);
+	MPI_Exscan(&nVertices, &vertexStart, 1, MPI_LONG_LONG, MPI_SUM, PETSC_COMM_WORLD);
+	MPI_Allreduce(&nTriangles, &allTriangles, 1, MPI_LONG_LONG, MPI_SUM, PETSC_COMM_WORLD);
+	MPI_Allreduce(&nVertices, &allVertices, 1, MPI_LONG_LONG, MPI_SUM, PETSC_COMM_WORLD);
+
+	if (rank == 0) {
+		// result of exscan is undefined on the first rank
+		triangleStart = 0;
+		vertexStart   = 0;
+	}
+
+	std::string fname(file);
+	fname += (format == ISO_STL) ? ".stl" : ".ply";
+
+	MPI_File   fh;
+	MPI_Status status;
+
+	if ( format == ISO_STL ) {
+		// no shared vertices, every rank writes its triangles as they are
+		std::vector<char> faces(nTriangles * stlFaceSize, 0);
+		for (long long t = 0; t < nTriangles; ++t) {
+			const float* c = &surf.corners[9*t];
+			Eigen::Vector3f n = (Eigen::Vector3f(c[3], c[4], c[5]) - Eigen::Vector3f(c[0], c[1], c[2]))
+			                    .cross(Eigen::Vector3f(c[6], c[7], c[8]) - Eigen::Vector3f(c[0], c[1], c[2]));
+			if ( n.norm() > 0 ) n.normalize();
+
+			char* f = &faces[t * stlFaceSize];
+			memcpy(f, n.data(), 3*sizeof(float));
+			memcpy(f + 3*sizeof(float), c, 9*sizeof(float));
+		}
+
+		MPI_File_open(PETSC_COMM_WORLD, &fname[0], MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+		MPI_File_set_size(fh, 0);
+
+		if (rank == 0) {
+			char     header[80] = "libLS isosurface";
+			uint32_t count      = allTriangles;
+			MPI_File_write_at(fh, 0, header, 80, MPI_BYTE, &status);
+			MPI_File_write_at(fh, 80, &count, sizeof(count), MPI_BYTE, &status);
+		}
+
+		MPI_File_write_at_all(fh, 84 + triangleStart * stlFaceSize, faces.data(), faces.size(), MPI_BYTE, &status);
+		MPI_File_close(&fh);
+
+		return;
+	}
+
+	// ask the owners for the ids of the vertices which are not ours
+	std::vector< std::vector<long long> > asked(nRanks);
+	std::unordered_map<long long, long long> ids;
+	for (size_t t = 0; t < surf.triangles.size(); ++t) {
+		long long key = surf.triangles[t];
+		if ( surf.owned.count(key) || ids.count(key) )
+			continue;
+
+		long long node   = key / 7;
+		PetscInt  ind[3] = {PetscInt(node % mx), PetscInt((node / mx) % my), PetscInt(node / (mx*my))};
+		int       owner  = gr.getOwner(ind);
+
+		ids[key] = -1;
+		asked[owner].push_back(key);
+	}
+
+	std::vector<int> sendCounts(nRanks), recvCounts(nRanks), sendOffsets(nRanks + 1, 0), recvOffsets(nRanks + 1, 0);
+	for (int r = 0; r < nRanks; ++r) {
+		sendCounts[r]      = asked[r].size();
+		sendOffsets[r + 1] = sendOffsets[r] + sendCounts[r];
+	}
+	MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, PETSC_COMM_WORLD);
+	for (int r = 0; r < nRanks; ++r) {
+		recvOffsets[r + 1] = recvOffsets[r] + recvCounts[r];
+	}
+
+	std::vector<long long> sendKeys(sendOffsets[nRanks]), recvKeys(recvOffsets[nRanks]);
+	for (int r = 0; r < nRanks; ++r) {
+		std::copy(asked[r].begin(), asked[r].end(), sendKeys.begin() + sendOffsets[r]);
+	}
+	MPI_Alltoallv(sendKeys.data(), sendCounts.data(), sendOffsets.data(), MPI_LONG_LONG,
+	              recvKeys.data(), recvCounts.data(), recvOffsets.data(), MPI_LONG_LONG, PETSC_COMM_WORLD);
+
+	// the edge is crossed for the owner too, it sees the same values
+	for (size_t q = 0; q < recvKeys.size(); ++q) {
+		recvKeys[q] = vertexStart + surf.owned[recvKeys[q]];
+	}
+
+	MPI_Alltoallv(recvKeys.data(), recvCounts.data(), recvOffsets.data(), MPI_LONG_LONG,
+	              sendKeys.data(), sendCounts.data(), sendOffsets.data(), MPI_LONG_LONG, PETSC_COMM_WORLD);
+
+	for (int r = 0; r < nRanks; ++r) {
+		for (size_t q = 0; q < asked[r].size(); ++q) {
+			ids[ asked[r][q] ] = sendKeys[sendOffsets[r] + q];
+		}
+	}
+
+	// pack vertices and faces
+	std::vector<char> vertices(surf.points.size() * sizeof(float));
+	memcpy(vertices.data(), surf.points.data(), vertices.size());
+
+	std::vector<char> faces(nTriangles * plyFaceSize);
+	for (long long t = 0; t < nTriangles; ++t) {
+		char* f = &faces[t * plyFaceSize];
+		f[0] = 3;
+		for (int v = 0; v < 3; ++v) {
+			long long key = surf.triangles[3*t + v];
+			std::unordered_map<long long, long int>::const_iterator own = surf.owned.find(key);
+			int32_t id = (own != surf.owned.end()) ? int32_t(vertexStart + own->second) : int32_t(ids[key]);
+			memcpy(f + 1 + v*sizeof(int32_t), &id, sizeof(int32_t));
+		}
+	}
+
+	char header[512];
+	int  headerSize = snprintf(header, 512, "ply\nformat %s 1.0\ncomment libLS isosurface %g\n"
+	                           "element vertex %lld\nproperty float x\nproperty float y\nproperty float z\n"
+	                           "element face %lld\nproperty list uchar int vertex_indices\nend_header\n",
+	                           plyByteOrder(), iso, allVertices, allTriangles);
+
+	MPI_File_open(PETSC_COMM_WORLD, &fname[0], MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+	MPI_File_set_size(fh, 0);
+
+	if (rank == 0) {
+		MPI_File_write_at(fh, 0, header, headerSize, MPI_BYTE, &status);
+	}
+
+	MPI_Offset faceBase = headerSize + allVertices * plyVertexSize;
+
+	MPI_File_write_at_all(fh, headerSize + vertexStart * plyVertexSize, vertices.data(), vertices.size(), MPI_BYTE, &status);
+	MPI_File_write_at_all(fh, faceBase + triangleStart * plyFaceSize, faces.data(), faces.size(), MPI_BYTE, &status);
+
+	MPI_File_close(&fh);
+
+}
+
+#endif /* ISOSURFACEWRITTER_HPP_ */
@@ -12,47 +12,51 @@
 #include <petscdmda.h>
 #include <petscsys.h>
 #include <petscviewer.h>
+#include <cstdio>
 #include <string>
+#include <algorithm>
 
 #include "Grid.hpp"
 #include "Interface.hpp"
+#include "SlabGather.hpp"
 
 namespace lsm {
 	#include "lsm_data_arrays.h"
 }
 
+/// Writes the interface in the LSMLIB format, .gr grid file and .data array.
+///
+/// The .data array is written as lsm::writeDataArray does, the dimensions of the ghost box
+/// followed by num_gridpts values of the lsm grid taken from the start of the natural ordered
+/// field, but rank 0 appends the slabs of SlabGather one by one, so no rank holds an array of
+/// the global size.
 class LSMWritter {
+
+	/// appends the slabs to the open file until remaining values are written
+	struct SlabSink {
+		FILE*    fp;
+		long int planeSize;
+		long int remaining;
+
+		void operator()(int k0, int k1, const PetscReal* slab) {
+			long int count = std::min(remaining, (k1 - k0) * planeSize);
+			fwrite(slab, sizeof(PetscReal), count, fp);
+			remaining -= count;
+		}
+	};
+
 public:
+	/// \param slabBudget memory of rank 0 for the slabs in bytes
 	template <typename type, int dim>
-	static void writeData(const Interface<type, dim>& data, char* file) {
+	static void writeData(const Interface<type, dim>& data, char* file, long int slabBudget = SlabGather::defaultBudget) {
 
 		int rank;
 		const Grid<type, dim>& gr = data.getGrid();
-		const DMDALocalInfo* info = gr.getLocalInfo();
-
-
-		long int length = gr.getM(0) * gr.getM(1) * gr.getM(2);
-
-
-		Vec        glob, seq;
-		VecScatter tolocalall, fromlocalall, sc;
-
-		DMCreateGlobalVector(info->da, &glob);
-
-
-		DMDAGlobalToNaturalAllCreate(info->da, &tolocalall);
-
-		DMLocalToGlobalBegin(info->da, data.getLocalData(), INSERT_VALUES, glob);
-		DMLocalToGlobalEnd(info->da, data.getLocalData(), INSERT_VALUES, glob);
-
-		VecCreateSeq(PETSC_COMM_SELF, length, &seq);
-
-		VecScatterBegin(tolocalall, glob, seq, INSERT_VALUES, SCATTER_FORWARD);
-		VecScatterEnd(tolocalall, glob, seq, INSERT_VALUES, SCATTER_FORWARD);
-
 
 		MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
 
+		SlabSink sink = {NULL, long(gr.getM(0)) * gr.getM(1), 0};
+
 		std::string fname_g(file);
 		std::string fname_d(file);
 
@@ -72,15 +76,23 @@ public:
 			tr[0] -= 2*dx[0]; tr[1] -= 2*dx[1]; tr[2] -= 2*dx[2];
 			dims[0] -= 4; dims[1] -= 4; dims[2] -= 4;
 
-			double * data;
-			VecGetArray(seq, &data);
-
 			lsm::Grid* toFile = lsm::createGridSetDx(dim, dx[0], bl, tr, lsm::LOW);
 			lsm::writeGridToAsciiFile(toFile, &fname_g[0], NO_ZIP);
-			lsm::writeDataArray(data, toFile, &fname_d[0], NO_ZIP);
 
-			VecRestoreArray(seq, &data);
+			// header of lsm::writeDataArray, the values follow slab by slab
+			sink.fp        = fopen(&fname_d[0], "wb");
+			sink.remaining = toFile->num_gridpts;
+			fwrite(toFile->grid_dims_ghostbox, sizeof(int), 3, sink.fp);
+		}
 
+		SlabGather::gather(data, sink, slabBudget);
+
+		if (rank == 0) {
+			// the lsm grid holds more points than the field, writeDataArray read past the array there
+			if (sink.remaining > 0) {
+				PetscPrintf(PETSC_COMM_SELF, "%s: %ld values of the lsm grid are not in the field\n", &fname_d[0], sink.remaining);
+			}
+			fclose(sink.fp);
 		}
 
 	}
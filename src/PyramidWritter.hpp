@@ -0,0 +1,200 @@
+/*
+ * PyramidWritter.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef PYRAMIDWRITTER_HPP_
+#define PYRAMIDWRITTER_HPP_
+
+#include <petscdmda.h>
+#include <petscsys.h>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "Grid.hpp"
+#include "Interface.hpp"
+#include "BINWritter.hpp"
+
+
+/// \brief Writes downsampled copies of the interface for previews, file.L1.data, file.L2.data, ...
+///
+/// Level l keeps every 2^l-th node, the files have the .data layout of BINWritter so the same
+/// readers load them. Coarse node takes the value of smallest magnitude among the fine nodes
+/// closer to it than to the other coarse nodes, with its sign. Thin parts of the interface
+/// are then not lost, the distance far from it is underestimated by at most half of the coarse cell.
+///
+/// Every rank restricts its owned nodes. Coarse node is owned by the rank owning its fine node,
+/// only partial values of the coarse nodes on the block boundaries are sent to their owners.
+/// Owned coarse blocks are written at once by collective MPI-IO.
+class PyramidWritter {
+
+	/// coarse index of the fine node n, coarse node I collects fine nodes I*f - f/2 <= n < I*f + f/2
+	static int coarseIndex(int n, int f, int mc) {
+		return std::min((n + f/2) / f, mc - 1);
+	}
+
+	/// keep the value of smaller magnitude
+	static void restrictTo(PetscReal& coarse, PetscReal fine) {
+		if ( std::abs(fine) < std::abs(coarse) )
+			coarse = fine;
+	}
+
+public:
+
+	/// \param levels number of levels, level l is 2^l times coarser
+	template <typename type, int dim>
+	static void writeData(const Interface<type, dim>& data, char* file, int levels = 3);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+template <typename type, int dim>
+void PyramidWritter::writeData(const Interface<type, dim>& data, char* file, int levels) {
+
+	int rank, nRanks;
+	const Grid<type, dim>& gr   = data.getGrid();
+	const DMDALocalInfo*   info = gr.getLocalInfo();
+
+	MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+	MPI_Comm_size(PETSC_COMM_WORLD, &nRanks);
+
+	std::vector<PetscReal> owned;
+	data.getOwnedData(owned);
+
+	const int M[3]     = {gr.getM(0), gr.getM(1), gr.getM(2)};
+	const int start[3] = {info->xs, info->ys, info->zs};
+	const int size[3]  = {info->xm, info->ym, info->zm};
+
+	for (int l = 1; l <= levels; ++l) {
+		const int f = 1 << l;
+
+		int    mc[3];
+		double dx[3], bl[3], tr[3];
+		for (int d = 0; d < 3; ++d) {
+			mc[d] = (M[d] - 1) / f + 1;
+			dx[d] = gr.getDx(d) * f;
+			bl[d] = gr.getMin(d);
+			tr[d] = bl[d] + (mc[d] - 1) * dx[d];
+		}
+
+		// coarse nodes touched by the owned block, and the owned ones, I*f inside the owned block
+		int plo[3], pm[3], olo[3], om[3];
+		for (int d = 0; d < 3; ++d) {
+			plo[d] = coarseIndex(start[d], f, mc[d]);
+			pm[d]  = coarseIndex(start[d] + size[d] - 1, f, mc[d]) - plo[d] + 1;
+			olo[d] = (start[d] + f - 1) / f;
+			om[d]  = std::max((start[d] + size[d] + f - 1) / f - olo[d], 0);
+		}
+
+		std::vector<PetscReal> partial(long(pm[0]) * pm[1] * pm[2], HUGE_VAL);
+
+		const PetscReal* v = owned.data();
+		for (int k = 0; k < size[2]; ++k) {
+			long int ck = coarseIndex(start[2] + k, f, mc[2]) - plo[2];
+			for (int j = 0; j < size[1]; ++j) {
+				long int cj = coarseIndex(start[1] + j, f, mc[1]) - plo[1];
+				for (int i = 0; i < size[0]; ++i, ++v) {
+					long int ci = coarseIndex(start[0] + i, f, mc[0]) - plo[0];
+					restrictTo(partial[ci + cj*pm[0] + ck*long(pm[0])*pm[1]], *v);
+				}
+			}
+		}
+
+		std::vector<PetscReal> coarse(long(om[0]) * om[1] * om[2], HUGE_VAL);
+
+		// own partial values go straight in, the others to the owners as (coarse index, value)
+		std::vector< std::vector<PetscReal> > toOwner(nRanks);
+		for (int k = 0; k < pm[2]; ++k) {
+			for (int j = 0; j < pm[1]; ++j) {
+				for (int i = 0; i < pm[0]; ++i) {
+					int       I[3] = {plo[0] + i, plo[1] + j, plo[2] + k};
+					PetscReal val  = partial[i + j*pm[0] + k*long(pm[0])*pm[1]];
+
+					bool mine = true;
+					for (int d = 0; d < 3; ++d) {
+						mine = mine && I[d] >= olo[d] && I[d] < olo[d] + om[d];
+					}
+
+					if (mine) {
+						restrictTo(coarse[(I[0] - olo[0]) + (I[1] - olo[1])*long(om[0]) + (I[2] - olo[2])*long(om[0])*om[1]], val);
+					} else {
+						PetscInt fine[3] = {I[0]*f, I[1]*f, I[2]*f};
+						std::vector<PetscReal>& out = toOwner[gr.getOwner(fine)];
+						out.push_back(I[0] + I[1]*double(mc[0]) + I[2]*double(mc[0])*mc[1]);
+						out.push_back(val);
+					}
+				}
+			}
+		}
+
+		std::vector<int> sendCounts(nRanks), recvCounts(nRanks), sendOffsets(nRanks + 1, 0), recvOffsets(nRanks + 1, 0);
+		for (int r = 0; r < nRanks; ++r) {
+			sendCounts[r]      = toOwner[r].size();
+			sendOffsets[r + 1] = sendOffsets[r] + sendCounts[r];
+		}
+		MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, PETSC_COMM_WORLD);
+		for (int r = 0; r < nRanks; ++r) {
+			recvOffsets[r + 1] = recvOffsets[r] + recvCounts[r];
+		}
+
+		std::vector<PetscReal> sendBuf(sendOffsets[nRanks]), recvBuf(recvOffsets[nRanks]);
+		for (int r = 0; r < nRanks; ++r) {
+			std::copy(toOwner[r].begin(), toOwner[r].end(), sendBuf.begin() + sendOffsets[r]);
+		}
+		MPI_Alltoallv(sendBuf.data(), sendCounts.data(), sendOffsets.data(), MPIU_REAL,
+		              recvBuf.data(), recvCounts.data(), recvOffsets.data(), MPIU_REAL, PETSC_COMM_WORLD);
+
+		for (size_t q = 0; q < recvBuf.size(); q += 2) {
+			long int ind = long(recvBuf[q]);
+			long int I[3] = {ind % mc[0], (ind / mc[0]) % mc[1], ind / (long(mc[0]) * mc[1])};
+			restrictTo(coarse[(I[0] - olo[0]) + (I[1] - olo[1])*long(om[0]) + (I[2] - olo[2])*long(om[0])*om[1]], recvBuf[q + 1]);
+		}
+
+		char levelName[32];
+		snprintf(levelName, 32, ".L%d.data", l);
+
+		std::string fname_d(file);
+		fname_d += levelName;
+
+		MPI_File   fh;
+		MPI_Status status;
+
+		MPI_File_open(PETSC_COMM_WORLD, &fname_d[0], MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh);
+		MPI_File_set_size(fh, 0);
+
+		if (rank == 0) {
+			char header[BINWritter::headerSize];
+			BINWritter::packHeader(mc, dx, bl, tr, header);
+			MPI_File_write_at(fh, 0, header, BINWritter::headerSize, MPI_BYTE, &status);
+		}
+
+		// deep levels leave some ranks with no coarse node, they join the collective write with nothing
+		MPI_Datatype filetype = MPI_DOUBLE;
+		if ( !coarse.empty() ) {
+			int sizes[3]    = {mc[2], mc[1], mc[0]};
+			int subsizes[3] = {om[2], om[1], om[0]};
+			int starts[3]   = {olo[2], olo[1], olo[0]};
+			MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C, MPI_DOUBLE, &filetype);
+			MPI_Type_commit(&filetype);
+		}
+
+		MPI_File_set_view(fh, BINWritter::headerSize, MPI_DOUBLE, filetype, "native", MPI_INFO_NULL);
+		MPI_File_write_at_all(fh, 0, coarse.data(), coarse.size(), MPI_DOUBLE, &status);
+
+		MPI_File_close(&fh);
+		if ( !coarse.empty() )
+			MPI_Type_free(&filetype);
+	}
+
+}
+
+#endif /* PYRAMIDWRITTER_HPP_ */
@@ -0,0 +1,168 @@
+/*
+ * SlabGather.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef SLABGATHER_HPP_
+#define SLABGATHER_HPP_
+
+#include <petscdmda.h>
+#include <petscsys.h>
+#include <vector>
+#include <algorithm>
+
+#include "Grid.hpp"
+#include "Interface.hpp"
+
+
+/// \brief Gathers the interface to rank 0 in z-slabs, for writers which need one serial file.
+///
+/// The grid is cut into slabs of whole xy planes, rank 0 receives one slab in natural order,
+/// hands it to the sink and drops it. Receives of the next slab are posted before the sink is
+/// called, so the communication runs while the previous slab is written. Memory of rank 0 is
+/// bounded by the slab budget, the other ranks send from their owned block.
+///
+/// The sink is called on rank 0 only as sink(k0, k1, values), values holds planes k0 <= k < k1.
+class SlabGather {
+
+	/// one slab in flight, packed pieces of the ranks and their requests
+	struct Slab {
+		int                      k0, k1;
+		std::vector<PetscReal>   received;
+		std::vector<long int>    offsets;  ///< of the rank pieces in received
+		std::vector<MPI_Request> requests;
+	};
+
+	/// part of the block of the rank inside the planes k0 <= k < k1
+	static int overlap(const int* block, int k0, int k1, int& z0, int& z1) {
+		z0 = std::max(block[4], k0);
+		z1 = std::min(block[4] + block[5], k1);
+		return std::max(z1 - z0, 0);
+	}
+
+public:
+
+	/// default slab budget of rank 0, in bytes
+	static const long int defaultBudget = 64L << 20;
+
+	/// number of planes of one slab, rank 0 keeps two slabs of values and two of received pieces
+	template <typename type, int dim>
+	static int getSlabPlanes(const Grid<type, dim>& gr, long int budget) {
+
+		long int plane = long(gr.getM(0)) * gr.getM(1) * sizeof(PetscReal);
+
+		return std::max(1L, std::min(long(gr.getM(2)), budget / (4 * plane)));
+
+	}
+
+	template <typename type, int dim, typename Sink>
+	static void gather(const Interface<type, dim>& data, Sink& sink, long int budget = defaultBudget);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+template <typename type, int dim, typename Sink>
+void SlabGather::gather(const Interface<type, dim>& data, Sink& sink, long int budget) {
+
+	int rank, nRanks;
+	const Grid<type, dim>& gr   = data.getGrid();
+	const DMDALocalInfo*   info = gr.getLocalInfo();
+
+	MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+	MPI_Comm_size(PETSC_COMM_WORLD, &nRanks);
+
+	const int mx = gr.getM(0);
+	const int my = gr.getM(1);
+	const int mz = gr.getM(2);
+	const int nz = getSlabPlanes(gr, budget);
+	const int nSlabs = (mz + nz - 1) / nz;
+
+	std::vector<PetscReal> owned;
+	data.getOwnedData(owned);
+
+	int me[6] = {info->xs, info->xm, info->ys, info->ym, info->zs, info->zm};
+	std::vector<int> blocks(rank == 0 ? 6*nRanks : 0);
+	MPI_Gather(me, 6, MPI_INT, blocks.data(), 6, MPI_INT, 0, PETSC_COMM_WORLD);
+
+	const long int ownedPlane = long(info->xm) * info->ym;
+
+	if (rank != 0) {
+		// the owned block is z slowest, so its part of every slab is contiguous, sends are in slab
+		// order as rank 0 posts its receives
+		for (int s = 0; s < nSlabs; ++s) {
+			int z0, z1;
+			if ( overlap(me, s*nz, std::min((s + 1)*nz, mz), z0, z1) > 0 ) {
+				MPI_Send(&owned[(z0 - info->zs) * ownedPlane], (z1 - z0) * ownedPlane, MPIU_REAL,
+				         0, s, PETSC_COMM_WORLD);
+			}
+		}
+		return;
+	}
+
+	Slab slabs[2];
+	std::vector<PetscReal> values;
+
+	for (int s = 0; s <= nSlabs; ++s) {
+		// post receives of slab s, while slab s-1 is unpacked and written
+		if (s < nSlabs) {
+			Slab& next = slabs[s % 2];
+			next.k0 = s*nz;
+			next.k1 = std::min((s + 1)*nz, mz);
+			next.offsets.assign(nRanks + 1, 0);
+			next.requests.clear();
+
+			for (int r = 0; r < nRanks; ++r) {
+				const int* b = &blocks[6*r];
+				int z0, z1;
+				next.offsets[r + 1] = next.offsets[r] + overlap(b, next.k0, next.k1, z0, z1) * long(b[1]) * b[3];
+			}
+			next.received.resize(next.offsets[nRanks]);
+
+			for (int r = 1; r < nRanks; ++r) {
+				long int count = next.offsets[r + 1] - next.offsets[r];
+				if (count > 0) {
+					next.requests.push_back(MPI_REQUEST_NULL);
+					MPI_Irecv(&next.received[next.offsets[r]], count, MPIU_REAL, r, s, PETSC_COMM_WORLD, &next.requests.back());
+				}
+			}
+
+			int z0, z1;
+			if ( overlap(me, next.k0, next.k1, z0, z1) > 0 ) {
+				std::copy(&owned[(z0 - info->zs) * ownedPlane], &owned[(z1 - info->zs) * ownedPlane],
+				          &next.received[0]);
+			}
+		}
+
+		if (s == 0)
+			continue;
+
+		Slab& cur = slabs[(s - 1) % 2];
+		MPI_Waitall(cur.requests.size(), cur.requests.data(), MPI_STATUSES_IGNORE);
+
+		values.resize( long(mx) * my * (cur.k1 - cur.k0) );
+		for (int r = 0; r < nRanks; ++r) {
+			const int* b = &blocks[6*r];
+			int z0, z1;
+			if ( overlap(b, cur.k0, cur.k1, z0, z1) == 0 )
+				continue;
+
+			const PetscReal* src = &cur.received[cur.offsets[r]];
+			for (int k = z0; k < z1; ++k) {
+				for (int j = b[2]; j < b[2] + b[3]; ++j, src += b[1]) {
+					std::copy(src, src + b[1], &values[ b[0] + j*long(mx) + (k - cur.k0)*long(mx)*my ]);
+				}
+			}
+		}
+
+		sink(cur.k0, cur.k1, values.data());
+	}
+
+}
+
+#endif /* SLABGATHER_HPP_ */
@@ -0,0 +1,365 @@
+/*
+ * SparseFastMarching.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef SPARSEFASTMARCHING_HPP_
+#define SPARSEFASTMARCHING_HPP_
+
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "FastMarching.hpp"
+#include "FmmHeap.hpp"
+#include "SparseGrid.hpp"
+
+
+/// \brief Fast marching on the leaves of SparseGrid, the band is marched out to the background only.
+///
+/// The same first order update as FastMarching, cells are numbered leaf * 512 + cell of the brick.
+/// A tile brick is turned into a leaf only when one of its cells gets a value below the background,
+/// so the band grows with the surface and not with the grid. Ranks exchange their halo leaves between
+/// the rounds and reopen the improved cells, as FastMarching::solveEikonalEquationParallel does with
+/// the ghost layer. Extension fields are not supported on the sparse grid.
+///
+/// \tparam precision type used to compare the keys in the heap (float or double)
+template <typename precision = double>
+class SparseFastMarching {
+
+	// zlib.h included by SparseGrid defines FAR
+	enum CellState {CELL_FAR = 0, CELL_TRIAL = 1, CELL_KNOWN = 2, CELL_FIXED = 3};
+
+	SparseGrid&        grid;
+	double             dx[3];
+	double             tolerance; ///< smallest improvement that reopens a computed cell
+
+	std::vector<char>  state;     ///< of every cell of the leaves
+	std::vector<char>  dirty;     ///< leaves changed since the last takeDirty
+	FmmHeap<precision> heap;
+
+	double& value(long cell) {
+		return grid.getLeaf(cell / SparseGrid::brickCells)[cell % SparseGrid::brickCells];
+	}
+
+	/// global node indices of the cell
+	void getIndices(long cell, long g[3]) const;
+
+	/// cell of the leaf holding the node, -1 for the nodes of tiles and the nodes out of the table
+	long find(const long g[3]) const;
+
+	/// tentative value of the node from its known neighbors, the node does not need to have a cell yet
+	double tentative(const long g[3], int& sign) const;
+
+	/// recompute tentative values of the neighbors of the cell, allocates the leaves the band reaches
+	void updateNeighbors(long cell);
+
+public:
+
+	SparseFastMarching(SparseGrid& _grid);
+
+	/// follow the leaves allocated outside of the march, by SparseGrid::exchangeHalo
+	void sync();
+
+	/// mark the band as fixed and build the initial front around it
+	void initialize();
+
+	/// march until the front is empty
+	void propagate();
+
+	void march();
+
+	/// offer a new value of the cell coming from the neighbor, the cell is queued again when it improves
+	bool reopen(long cell, double value);
+
+	/// leaves changed since the last call
+	void takeDirty(std::vector<int32_t>& leaves);
+
+	/// march the band of the whole grid, ranks exchange their halo leaves until nothing changes,
+	/// the signs of the grid are resolved at the end, returns number of exchange rounds
+	static int solveEikonalEquation(SparseGrid& grid);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+template <typename precision>
+SparseFastMarching<precision>::SparseFastMarching(SparseGrid& _grid) : grid(_grid), heap(0) {
+
+	for (int d = 0; d < 3; ++d) {
+		dx[d] = grid.getDx(d);
+	}
+
+	tolerance = 1E-10 * std::min(dx[0], std::min(dx[1], dx[2]));
+
+	sync();
+
+}
+
+template <typename precision>
+void SparseFastMarching<precision>::sync() {
+
+	long numberOfCells = grid.getNumberOfLeaves() * SparseGrid::brickCells;
+
+	if ( long(state.size()) < numberOfCells ) {
+		state.resize(numberOfCells, CELL_FAR);
+		dirty.resize(grid.getNumberOfLeaves(), 0);
+		heap.resize(numberOfCells);
+	}
+
+}
+
+template <typename precision>
+void SparseFastMarching<precision>::getIndices(long cell, long g[3]) const {
+
+	const int bs = SparseGrid::brickSize;
+
+	int  b[3];
+	int  c = cell % SparseGrid::brickCells;
+	grid.getBrickCoords(grid.getLeafBrick(cell / SparseGrid::brickCells), b);
+
+	g[0] = long(b[0]) * bs + c % bs;
+	g[1] = long(b[1]) * bs + (c / bs) % bs;
+	g[2] = long(b[2]) * bs + c / (bs * bs);
+
+}
+
+template <typename precision>
+long SparseFastMarching<precision>::find(const long g[3]) const {
+
+	const int bs = SparseGrid::brickSize;
+
+	for (int d = 0; d < 3; ++d) {
+		if ( g[d] < 0 || g[d] >= grid.getM(d) )
+			return -1;
+	}
+
+	long entry = grid.getTableIndex(g[0] / bs, g[1] / bs, g[2] / bs);
+	if ( entry < 0 )
+		return -1;
+
+	int32_t leaf = grid.getEntry(entry);
+	if ( leaf < 0 )
+		return -1;
+
+	return long(leaf) * SparseGrid::brickCells + (g[0] % bs) + bs * ( (g[1] % bs) + bs * (g[2] % bs) );
+
+}
+
+template <typename precision>
+double SparseFastMarching<precision>::tentative(const long g[3], int& sign) const {
+
+	double a[3], h[3];
+	int    sgn[3];
+	long   src[3];
+	int    count = 0;
+
+	// smallest known neighbor along each axis
+	for (int d = 0; d < 3; ++d) {
+		double best = std::numeric_limits<double>::max();
+		int    bs   = 0;
+		long   bc   = 0;
+
+		for (int dir = -1; dir <= 1; dir += 2) {
+			long n[3] = {g[0], g[1], g[2]};
+			n[d] += dir;
+
+			long c = find(n);
+			if ( c < 0 || state[c] < CELL_KNOWN )
+				continue;
+
+			double v = grid.getLeaf(c / SparseGrid::brickCells)[c % SparseGrid::brickCells];
+			if ( std::abs(v) < best ) {
+				best = std::abs(v);
+				bs   = (v < 0) ? -1 : 1;
+				bc   = c;
+			}
+		}
+
+		if ( bs != 0 ) {
+			a[count]   = best;
+			h[count]   = dx[d];
+			sgn[count] = bs;
+			src[count] = bc;
+			count++;
+		}
+	}
+
+	if ( count == 0 )
+		return std::numeric_limits<double>::max();
+
+	return FastMarching<precision>::upwind(a, h, sgn, src, count, sign);
+
+}
+
+template <typename precision>
+void SparseFastMarching<precision>::updateNeighbors(long cell) {
+
+	const int bs = SparseGrid::brickSize;
+
+	long g[3];
+	getIndices(cell, g);
+
+	for (int d = 0; d < 3; ++d) {
+		for (int dir = -1; dir <= 1; dir += 2) {
+			long n[3] = {g[0], g[1], g[2]};
+			n[d] += dir;
+			if ( n[d] < 0 || n[d] >= grid.getM(d) )
+				continue;
+
+			long neighbor = find(n);
+			if ( neighbor >= 0 && state[neighbor] == CELL_FIXED )
+				continue;
+
+			int    sign;
+			double u = tentative(n, sign);
+
+			// the band ends at the background, the tiles beyond it keep no values
+			if ( !(u < grid.getBackground()) )
+				continue;
+
+			if ( neighbor < 0 ) {
+				long entry = grid.getTableIndex(n[0] / bs, n[1] / bs, n[2] / bs);
+				if ( entry < 0 )
+					continue;
+
+				grid.activate(entry);
+				sync();
+				neighbor = find(n);
+			}
+
+			// known cells are rolled back only when the improvement is real, not a round off
+			double& phi = value(neighbor);
+			if ( u < std::abs(phi) - tolerance ) {
+				phi             = sign * u;
+				state[neighbor] = CELL_TRIAL;
+				heap.push(neighbor, precision(u));
+				dirty[neighbor / SparseGrid::brickCells] = 1;
+			}
+		}
+	}
+
+}
+
+template <typename precision>
+void SparseFastMarching<precision>::initialize() {
+
+	sync();
+	heap.clear();
+
+	long numberOfCells = state.size();
+
+	for (long c = 0; c < numberOfCells; ++c) {
+		state[c] = ( std::abs(value(c)) < FastMarching<precision>::farValue ) ? CELL_FIXED : CELL_FAR;
+	}
+
+	std::fill(dirty.begin(), dirty.end(), 1);
+
+	// the initial front are neighbors of the fixed band, the leaves allocated meanwhile hold no fixed cells
+	for (long c = 0; c < numberOfCells; ++c) {
+		if ( state[c] == CELL_FIXED )
+			updateNeighbors(c);
+	}
+
+}
+
+template <typename precision>
+void SparseFastMarching<precision>::propagate() {
+
+	while ( !heap.empty() ) {
+		long cell   = heap.pop();
+		state[cell] = CELL_KNOWN;
+		updateNeighbors(cell);
+	}
+
+}
+
+template <typename precision>
+void SparseFastMarching<precision>::march() {
+
+	initialize();
+	propagate();
+
+}
+
+template <typename precision>
+bool SparseFastMarching<precision>::reopen(long cell, double v) {
+
+	if ( state[cell] == CELL_FIXED )
+		return false;
+
+	double& phi = value(cell);
+	if ( !(std::abs(v) < std::abs(phi) - tolerance) )
+		return false;
+
+	phi         = v;
+	state[cell] = CELL_TRIAL;
+	heap.push(cell, precision(std::abs(v)));
+	dirty[cell / SparseGrid::brickCells] = 1;
+
+	return true;
+
+}
+
+template <typename precision>
+void SparseFastMarching<precision>::takeDirty(std::vector<int32_t>& leaves) {
+
+	leaves.clear();
+
+	for (size_t leaf = 0; leaf < dirty.size(); ++leaf) {
+		if ( dirty[leaf] ) {
+			leaves.push_back(leaf);
+			dirty[leaf] = 0;
+		}
+	}
+
+}
+
+template <typename precision>
+int SparseFastMarching<precision>::solveEikonalEquation(SparseGrid& grid) {
+
+	SparseFastMarching<precision> fmm(grid);
+	fmm.march();
+
+	std::vector<int32_t> leaves, received;
+	std::vector<double>  values;
+	int                  rounds = 0;
+
+	while ( true ) {
+
+		// owners publish the leaves changed since the last round, the halo receives them
+		fmm.takeDirty(leaves);
+		grid.exchangeHalo(leaves, received, values);
+		fmm.sync();
+
+		int changed = 0, anyChanged = 0;
+		for (size_t r = 0; r < received.size(); ++r) {
+			long first = long(received[r]) * SparseGrid::brickCells;
+			for (int c = 0; c < SparseGrid::brickCells; ++c) {
+				if ( fmm.reopen(first + c, values[r * SparseGrid::brickCells + c]) )
+					changed = 1;
+			}
+		}
+
+		MPI_Allreduce(&changed, &anyChanged, 1, MPI_INT, MPI_LOR, grid.getComm());
+
+		if ( !anyChanged )
+			break;
+
+		fmm.propagate();
+		rounds++;
+	}
+
+	grid.resolveSigns();
+
+	return rounds;
+
+}
+
+#endif /* SPARSEFASTMARCHING_HPP_ */
@@ -0,0 +1,639 @@
+/*
+ * SparseGrid.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef SPARSEGRID_HPP_
+#define SPARSEGRID_HPP_
+
+#include <mpi.h>
+#include <petscsys.h>
+#include <stdint.h>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <Eigen/Dense>
+
+#include "BoundingBox.hpp"
+#include "BandFormat.hpp"
+
+
+/// \brief Narrow band of the interface stored in bricks of 8^3 cells, for grids too large to be stored dense
+///
+/// Every rank owns a block of the brick lattice and keeps a dense table of the bricks of the block and one
+/// brick of halo around it, one int32 per brick. An entry of the table is either a leaf, 512 values of the
+/// brick, or a tile, a brick whose cells all hold the background value with the sign of the tile. Leaves
+/// exist only where a cell is closer to the interface than the background, so their memory grows with the
+/// area of the surface, while the table grows with the volume of the block, 4 bytes per 512 cells, 1/1024
+/// of the dense grid. For 4096^3 nodes the tables of all ranks take 512 MB. No DMDA is created.
+///
+/// Halo leaves are copies of the leaves of the neighbors, exchangeHalo updates them as the ghost layer
+/// of the DMDA is updated. Nodes are placed as in Grid, M nodes span [minX, maxX], bricks start at the
+/// first node, so the owned blocks are split into bricks the same way BandWritter splits them.
+class SparseGrid {
+public:
+
+	static const int brickSize  = bandBrickSize;
+	static const int brickCells = bandBrickSize * bandBrickSize * bandBrickSize;
+
+	/// table entries of the bricks without a leaf
+	enum Tile {
+		TILE_UNKNOWN = -1, ///< sign not known yet
+		TILE_OUTSIDE = -2, ///< +background
+		TILE_INSIDE  = -3  ///< -background
+	};
+
+private:
+
+	/// leaves are kept in pages, so the values do not move when more leaves are allocated
+	static const int leavesPerPage = 256;
+
+	struct LeafRecord {
+		int32_t brick[3];
+		int32_t reserved;
+		double  values[brickCells];
+	};
+
+	struct TileRecord {
+		int32_t brick[3];
+		int32_t tile;
+	};
+
+	MPI_Comm comm;
+	int      rank, nRanks;
+
+	long int dims[3];        ///< number of nodes
+	double   minX[3], maxX[3], dx[3];
+	double   background;
+
+	int      nBricks[3];     ///< brick lattice of the whole grid
+	int      procs[3];       ///< ranks along each dimension, numbered x fastest
+	int      ownedLo[3], ownedHi[3];
+	int      tableLo[3], tableHi[3], tableSize[3];
+
+	std::vector<int32_t>               table;
+	std::vector< std::vector<double> > pages;
+	std::vector<long int>              leafBrick; ///< table entry of every leaf
+
+	/// first brick owned by the ranks with coordinate c along d
+	int firstBrick(int d, int c) const {
+		return long(nBricks[d]) * c / procs[d];
+	}
+
+	/// coordinate of the rank owning brick b along d
+	int ownerCoordinate(int d, int b) const;
+
+	/// ranks other than this one with brick b in their table
+	void getNeighborRanks(const int b[3], std::vector<int>& ranks) const;
+
+	/// sign of the cell farthest from the interface on the face of the leaf, side is -1 or +1
+	int faceSign(int32_t leaf, int d, int side) const;
+
+	/// bins[r] is sent to rank r, everything sent to this rank is returned
+	template <typename Record>
+	void exchange(std::vector< std::vector<Record> >& bins, std::vector<Record>& received) const;
+
+public:
+
+	/// value of the leaf cells not computed yet, as in the dense interface before initialization
+	static double unset() {
+		return std::numeric_limits<double>::max();
+	}
+
+	/// \param minX      first node
+	/// \param maxX      last node
+	/// \param M         number of nodes along each dimension
+	/// \param bandWidth half width of the band in units of the smallest dx, the magnitude of the background
+	SparseGrid(const PetscReal* minX, const PetscReal* maxX, const PetscInt* M, double bandWidth, MPI_Comm comm = PETSC_COMM_WORLD);
+
+	MPI_Comm getComm() const {
+		return comm;
+	}
+
+	long int getM(int d) const {
+		return dims[d];
+	}
+
+	double getDx(int d) const {
+		return dx[d];
+	}
+
+	double getMin(int d) const {
+		return minX[d];
+	}
+
+	double getMax(int d) const {
+		return maxX[d];
+	}
+
+	double getBackground() const {
+		return background;
+	}
+
+	Eigen::Vector3d getCoord(long int i, long int j, long int k) const {
+		return Eigen::Vector3d(minX[0] + i*dx[0], minX[1] + j*dx[1], minX[2] + k*dx[2]);
+	}
+
+	/// bricks owned by this rank, [lo, hi)
+	void getOwnedBricks(int lo[3], int hi[3]) const;
+
+	/// bricks of the table, the owned ones with the halo, [lo, hi)
+	void getTableBricks(int lo[3], int hi[3]) const;
+
+	bool isOwned(const int b[3]) const;
+
+	/// entry of the brick in the table, -1 when the brick is not in it
+	long int getTableIndex(int bi, int bj, int bk) const;
+
+	void getBrickCoords(long int entry, int b[3]) const;
+
+	/// leaf index or Tile
+	int32_t getEntry(long int entry) const {
+		return table[entry];
+	}
+
+	/// leaf of the entry, a tile is turned into a leaf with all cells set to fill
+	int32_t activate(long int entry, double fill = unset());
+
+	long int getNumberOfLeaves() const {
+		return leafBrick.size();
+	}
+
+	/// table entry of the leaf
+	long int getLeafBrick(int32_t leaf) const {
+		return leafBrick[leaf];
+	}
+
+	/// values of the leaf, x fastest, cells behind the last node are never used
+	double* getLeaf(int32_t leaf) {
+		return &pages[leaf / leavesPerPage][long(leaf % leavesPerPage) * brickCells];
+	}
+
+	const double* getLeaf(int32_t leaf) const {
+		return &pages[leaf / leavesPerPage][long(leaf % leavesPerPage) * brickCells];
+	}
+
+	/// value of the node, the node has to be in the table
+	double getValue(long int i, long int j, long int k) const;
+
+	/// region of the table nodes grown by margin, triangles reaching a table node within margin overlap it
+	Box<double, 3> getNodeSpan(double margin) const;
+
+	/// box of the node indices around bb, padded as Grid::getGlobalBoxIndices
+	Box<PetscInt, 3> getGlobalBoxIndices(const Box<double, 3>& bb) const;
+
+	/// ranks with any node of the box of global indices in their table
+	std::vector<int> getTableOwners(const Box<PetscInt, 3>& indices) const;
+
+	/// Sends the owned leaves among leaves to the ranks holding them in the halo. Collective.
+	/// The leaves received are allocated when needed and returned with their values, they are not
+	/// written to the grid, the caller decides which values to take.
+	void exchangeHalo(const std::vector<int32_t>& leaves, std::vector<int32_t>& received, std::vector<double>& values);
+
+	/// Gives every cell not computed and every tile its sign and the background value, the values
+	/// of the leaves are clamped to the background. Tile signs are flooded from the faces of the leaves
+	/// through the inactive bricks, across the ranks too. Collective.
+	void resolveSigns();
+
+	/// bytes held by the table and the leaves of this rank
+	long int memory() const;
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+inline SparseGrid::SparseGrid(const PetscReal* _minX, const PetscReal* _maxX, const PetscInt* M, double bandWidth, MPI_Comm _comm) :
+		comm(_comm) {
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &nRanks);
+
+	for (int d = 0; d < 3; ++d) {
+		dims[d]    = M[d];
+		minX[d]    = _minX[d];
+		maxX[d]    = _maxX[d];
+		dx[d]      = (maxX[d] - minX[d]) / (M[d] - 1);
+		nBricks[d] = (M[d] + brickSize - 1) / brickSize;
+		procs[d]   = 0;
+	}
+
+	background = bandWidth * std::min(dx[0], std::min(dx[1], dx[2]));
+
+	MPI_Dims_create(nRanks, 3, procs);
+
+	int coords[3] = {rank % procs[0], (rank / procs[0]) % procs[1], rank / (procs[0] * procs[1])};
+
+	bool empty = false;
+	for (int d = 0; d < 3; ++d) {
+		ownedLo[d] = firstBrick(d, coords[d]);
+		ownedHi[d] = firstBrick(d, coords[d] + 1);
+		tableLo[d] = std::max(ownedLo[d] - 1, 0);
+		tableHi[d] = std::min(ownedHi[d] + 1, nBricks[d]);
+		empty      = empty || ownedLo[d] == ownedHi[d];
+	}
+
+	// more ranks than bricks along some dimension, this one has nothing
+	for (int d = 0; d < 3; ++d) {
+		if ( empty )
+			tableLo[d] = tableHi[d] = ownedLo[d] = ownedHi[d];
+		tableSize[d] = tableHi[d] - tableLo[d];
+	}
+
+	table.assign(long(tableSize[0]) * tableSize[1] * tableSize[2], TILE_UNKNOWN);
+
+}
+
+inline int SparseGrid::ownerCoordinate(int d, int b) const {
+
+	int c = int( (long(b) * procs[d]) / nBricks[d] );
+
+	while ( c + 1 < procs[d] && firstBrick(d, c + 1) <= b ) {
+		++c;
+	}
+	while ( c > 0 && firstBrick(d, c) > b ) {
+		--c;
+	}
+
+	return c;
+
+}
+
+inline void SparseGrid::getOwnedBricks(int lo[3], int hi[3]) const {
+
+	for (int d = 0; d < 3; ++d) {
+		lo[d] = ownedLo[d];
+		hi[d] = ownedHi[d];
+	}
+
+}
+
+inline void SparseGrid::getTableBricks(int lo[3], int hi[3]) const {
+
+	for (int d = 0; d < 3; ++d) {
+		lo[d] = tableLo[d];
+		hi[d] = tableHi[d];
+	}
+
+}
+
+inline bool SparseGrid::isOwned(const int b[3]) const {
+
+	for (int d = 0; d < 3; ++d) {
+		if ( b[d] < ownedLo[d] || b[d] >= ownedHi[d] )
+			return false;
+	}
+
+	return true;
+
+}
+
+inline long int SparseGrid::getTableIndex(int bi, int bj, int bk) const {
+
+	if ( bi < tableLo[0] || bi >= tableHi[0] || bj < tableLo[1] || bj >= tableHi[1] || bk < tableLo[2] || bk >= tableHi[2] )
+		return -1;
+
+	return (bi - tableLo[0]) + tableSize[0] * ( (bj - tableLo[1]) + long(tableSize[1]) * (bk - tableLo[2]) );
+
+}
+
+inline void SparseGrid::getBrickCoords(long int entry, int b[3]) const {
+
+	b[0] = tableLo[0] + entry % tableSize[0];
+	entry /= tableSize[0];
+	b[1] = tableLo[1] + entry % tableSize[1];
+	b[2] = tableLo[2] + entry / tableSize[1];
+
+}
+
+inline int32_t SparseGrid::activate(long int entry, double fill) {
+
+	if ( table[entry] >= 0 )
+		return table[entry];
+
+	int32_t leaf = leafBrick.size();
+	if ( leaf % leavesPerPage == 0 )
+		pages.push_back( std::vector<double>(long(leavesPerPage) * brickCells) );
+
+	std::fill(getLeaf(leaf), getLeaf(leaf) + brickCells, fill);
+
+	leafBrick.push_back(entry);
+	table[entry] = leaf;
+
+	return leaf;
+
+}
+
+inline double SparseGrid::getValue(long int i, long int j, long int k) const {
+
+	int32_t e = table[ getTableIndex(i / brickSize, j / brickSize, k / brickSize) ];
+
+	if ( e >= 0 )
+		return getLeaf(e)[ (i % brickSize) + brickSize * ( (j % brickSize) + brickSize * (k % brickSize) ) ];
+
+	return (e == TILE_INSIDE) ? -background : background;
+
+}
+
+inline Box<double, 3> SparseGrid::getNodeSpan(double margin) const {
+
+	double lo[3], hi[3];
+	for (int d = 0; d < 3; ++d) {
+		lo[d] = minX[d] + long(tableLo[d]) * brickSize * dx[d] - margin;
+		hi[d] = minX[d] + (std::min(long(tableHi[d]) * brickSize, dims[d]) - 1) * dx[d] + margin;
+	}
+
+	return Box<double, 3>(lo, hi);
+
+}
+
+inline Box<PetscInt, 3> SparseGrid::getGlobalBoxIndices(const Box<double, 3>& bb) const {
+
+	PetscInt padding = 2;
+	PetscInt gMin[3], gMax[3];
+
+	for (int d = 0; d < 3; ++d) {
+		gMin[d] = floor( (bb.minX(d) - minX[d]) / dx[d] ) - padding;
+		gMax[d] = ceil(  (bb.maxX(d) - minX[d]) / dx[d] ) + padding;
+
+		gMin[d] = std::max(gMin[d], PetscInt(0));
+		gMax[d] = std::min(gMax[d], PetscInt(dims[d] - 1));
+	}
+
+	return Box<PetscInt, 3>(gMin, gMax);
+
+}
+
+inline std::vector<int> SparseGrid::getTableOwners(const Box<PetscInt, 3>& indices) const {
+
+	// a table holds one brick around the owned ones
+	int first[3], last[3];
+	for (int d = 0; d < 3; ++d) {
+		if ( indices.maxX(d) < indices.minX(d) )
+			return std::vector<int>();
+
+		first[d] = ownerCoordinate( d, std::max(int(indices.minX(d) / brickSize) - 1, 0) );
+		last[d]  = ownerCoordinate( d, std::min(int(indices.maxX(d) / brickSize) + 1, nBricks[d] - 1) );
+	}
+
+	std::vector<int> owners;
+	for (int k = first[2]; k <= last[2]; ++k) {
+		for (int j = first[1]; j <= last[1]; ++j) {
+			for (int i = first[0]; i <= last[0]; ++i) {
+				owners.push_back( i + procs[0] * (j + procs[1] * k) );
+			}
+		}
+	}
+
+	return owners;
+
+}
+
+inline void SparseGrid::getNeighborRanks(const int b[3], std::vector<int>& ranks) const {
+
+	ranks.clear();
+
+	for (int dk = -1; dk <= 1; ++dk) {
+		for (int dj = -1; dj <= 1; ++dj) {
+			for (int di = -1; di <= 1; ++di) {
+				int n[3] = {b[0] + di, b[1] + dj, b[2] + dk};
+				if ( n[0] < 0 || n[0] >= nBricks[0] || n[1] < 0 || n[1] >= nBricks[1] || n[2] < 0 || n[2] >= nBricks[2] )
+					continue;
+
+				int owner = ownerCoordinate(0, n[0]) + procs[0] * ( ownerCoordinate(1, n[1]) + procs[1] * ownerCoordinate(2, n[2]) );
+				if ( owner != rank && std::find(ranks.begin(), ranks.end(), owner) == ranks.end() )
+					ranks.push_back(owner);
+			}
+		}
+	}
+
+}
+
+template <typename Record>
+void SparseGrid::exchange(std::vector< std::vector<Record> >& bins, std::vector<Record>& received) const {
+
+	std::vector<int>    sendCounts(nRanks), recvCounts(nRanks), sendOffsets(nRanks), recvOffsets(nRanks);
+	std::vector<Record> send;
+
+	for (int r = 0; r < nRanks; ++r) {
+		sendOffsets[r] = send.size() * sizeof(Record);
+		sendCounts[r]  = bins[r].size() * sizeof(Record);
+		send.insert(send.end(), bins[r].begin(), bins[r].end());
+		std::vector<Record>().swap(bins[r]);
+	}
+
+	MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, comm);
+
+	int total = 0;
+	for (int r = 0; r < nRanks; ++r) {
+		recvOffsets[r] = total;
+		total         += recvCounts[r];
+	}
+
+	received.resize(total / sizeof(Record));
+	MPI_Alltoallv(send.data(), sendCounts.data(), sendOffsets.data(), MPI_BYTE,
+	              received.data(), recvCounts.data(), recvOffsets.data(), MPI_BYTE, comm);
+
+}
+
+inline void SparseGrid::exchangeHalo(const std::vector<int32_t>& leaves, std::vector<int32_t>& received, std::vector<double>& values) {
+
+	std::vector< std::vector<LeafRecord> > bins(nRanks);
+	std::vector<int>                       ranks;
+	LeafRecord                             record;
+
+	record.reserved = 0;
+
+	for (auto leaf: leaves) {
+		int b[3];
+		getBrickCoords(leafBrick[leaf], b);
+		if ( !isOwned(b) )
+			continue;
+
+		getNeighborRanks(b, ranks);
+		if ( ranks.empty() )
+			continue;
+
+		for (int d = 0; d < 3; ++d) {
+			record.brick[d] = b[d];
+		}
+		memcpy(record.values, getLeaf(leaf), sizeof(record.values));
+
+		for (auto r: ranks) {
+			bins[r].push_back(record);
+		}
+	}
+
+	std::vector<LeafRecord> in;
+	exchange(bins, in);
+
+	received.clear();
+	values.clear();
+
+	for (auto& r: in) {
+		long int entry = getTableIndex(r.brick[0], r.brick[1], r.brick[2]);
+		if ( entry < 0 )
+			continue;
+
+		received.push_back( activate(entry) );
+		values.insert(values.end(), r.values, r.values + brickCells);
+	}
+
+}
+
+inline int SparseGrid::faceSign(int32_t leaf, int d, int side) const {
+
+	const double* v     = getLeaf(leaf);
+	int           layer = (side < 0) ? 0 : brickSize - 1;
+	double        far   = 0;
+
+	for (int c = 0; c < brickCells; ++c) {
+		int l[3] = {c % brickSize, (c / brickSize) % brickSize, c / (brickSize * brickSize)};
+		if ( l[d] == layer && std::abs(v[c]) > std::abs(far) )
+			far = v[c];
+	}
+
+	return (far < 0) ? -1 : 1;
+
+}
+
+inline void SparseGrid::resolveSigns() {
+
+	// cells of the leaves the march did not reach take the sign of a reached neighbor in the leaf
+	std::vector<int> queue;
+	for (long int leaf = 0; leaf < getNumberOfLeaves(); ++leaf) {
+		double* v = getLeaf(leaf);
+
+		queue.clear();
+		for (int c = 0; c < brickCells; ++c) {
+			if ( v[c] != unset() )
+				queue.push_back(c);
+		}
+
+		// a leaf is allocated only when one of its cells gets a value, this is just a guard
+		if ( queue.empty() )
+			std::fill(v, v + brickCells, background);
+
+		for (size_t q = 0; q < queue.size(); ++q) {
+			int c    = queue[q];
+			int l[3] = {c % brickSize, (c / brickSize) % brickSize, c / (brickSize * brickSize)};
+			int s[3] = {1, brickSize, brickSize * brickSize};
+
+			for (int d = 0; d < 3; ++d) {
+				for (int dir = -1; dir <= 1; dir += 2) {
+					if ( l[d] + dir < 0 || l[d] + dir >= brickSize )
+						continue;
+
+					int n = c + dir * s[d];
+					if ( v[n] == unset() ) {
+						v[n] = (v[c] < 0) ? -background : background;
+						queue.push_back(n);
+					}
+				}
+			}
+		}
+
+		for (int c = 0; c < brickCells; ++c) {
+			if ( std::abs(v[c]) > background )
+				v[c] = (v[c] < 0) ? -background : background;
+		}
+	}
+
+	// tiles touching a leaf take the sign of its face, the surface does not come closer than the background
+	std::vector<long int> fresh;
+	for (long int leaf = 0; leaf < getNumberOfLeaves(); ++leaf) {
+		int b[3];
+		getBrickCoords(leafBrick[leaf], b);
+
+		for (int d = 0; d < 3; ++d) {
+			for (int side = -1; side <= 1; side += 2) {
+				int n[3] = {b[0], b[1], b[2]};
+				n[d] += side;
+
+				long int entry = getTableIndex(n[0], n[1], n[2]);
+				if ( entry >= 0 && table[entry] == TILE_UNKNOWN ) {
+					table[entry] = (faceSign(leaf, d, side) < 0) ? TILE_INSIDE : TILE_OUTSIDE;
+					fresh.push_back(entry);
+				}
+			}
+		}
+	}
+
+	// flood the tiles, the owned tiles resolved in a round are sent to the halo of the neighbors
+	std::vector< std::vector<TileRecord> > bins(nRanks);
+	std::vector<TileRecord>                in;
+	std::vector<int>                       ranks;
+
+	while ( true ) {
+		for (size_t q = 0; q < fresh.size(); ++q) {
+			int b[3];
+			getBrickCoords(fresh[q], b);
+
+			for (int d = 0; d < 3; ++d) {
+				for (int side = -1; side <= 1; side += 2) {
+					int n[3] = {b[0], b[1], b[2]};
+					n[d] += side;
+
+					long int entry = getTableIndex(n[0], n[1], n[2]);
+					if ( entry >= 0 && table[entry] == TILE_UNKNOWN ) {
+						table[entry] = table[fresh[q]];
+						fresh.push_back(entry);
+					}
+				}
+			}
+		}
+
+		for (auto entry: fresh) {
+			int b[3];
+			getBrickCoords(entry, b);
+			if ( !isOwned(b) )
+				continue;
+
+			getNeighborRanks(b, ranks);
+
+			TileRecord record = { {b[0], b[1], b[2]}, table[entry] };
+			for (auto r: ranks) {
+				bins[r].push_back(record);
+			}
+		}
+
+		exchange(bins, in);
+
+		fresh.clear();
+		for (auto& r: in) {
+			long int entry = getTableIndex(r.brick[0], r.brick[1], r.brick[2]);
+			if ( entry >= 0 && table[entry] == TILE_UNKNOWN ) {
+				table[entry] = r.tile;
+				fresh.push_back(entry);
+			}
+		}
+
+		int changed = fresh.empty() ? 0 : 1, anyChanged = 0;
+		MPI_Allreduce(&changed, &anyChanged, 1, MPI_INT, MPI_LOR, comm);
+
+		if ( !anyChanged )
+			break;
+	}
+
+	// no surface in reach at all
+	for (size_t entry = 0; entry < table.size(); ++entry) {
+		if ( table[entry] == TILE_UNKNOWN )
+			table[entry] = TILE_OUTSIDE;
+	}
+
+}
+
+inline long int SparseGrid::memory() const {
+
+	return table.size() * sizeof(int32_t) + pages.size() * long(leavesPerPage) * brickCells * sizeof(double)
+	     + leafBrick.size() * sizeof(long int);
+
+}
+
+#endif /* SPARSEGRID_HPP_ */
@@ -84,9 +84,6 @@ void SphereInitializer::operator ()(Interface<type, dim>& interface, bool initAl
     double***     data_ptr;
     int           x, y, z, m, n, p;
     int           vecSize;
-    DM            cda;
-    Vec           gc;
-    DMDACoor3d*** coors;
 
     VecSet(localData, std::numeric_limits<double>::max());
 //    VecSet(localData, -0.5);
@@ -106,11 +103,6 @@ void SphereInitializer::operator ()(Interface<type, dim>& interface, bool initAl
     
     DMDAGetGhostCorners(gr.getDA(), &x, &y, &z, &m, &n, &p);
 
-    DMGetCoordinatesLocal(gr.getDA() ,&gc);
-    DMGetCoordinateDM(gr.getDA(), &cda);
-    DMDAVecGetArray(cda, gc, &coors);
-
-
     if (initAll) {
         // initialize the whole domain
         
@@ -119,9 +111,7 @@ void SphereInitializer::operator ()(Interface<type, dim>& interface, bool initAl
                 for (int k = z; k < z+p; ++k) {
                     data_ptr[k][j][i] = 
                         sphereEquation(
-                            Eigen::Vector3d(coors[k][j][i].x,
-                                            coors[k][j][i].y,
-                                            coors[k][j][i].z)                            
+                            gr.getCoord(i, j, k)
                         );
 
                 }
@@ -136,9 +126,7 @@ void SphereInitializer::operator ()(Interface<type, dim>& interface, bool initAl
                 for (int k = z; k < z+p; ++k) {
                     double dist = 
                         sphereEquation(
-                            Eigen::Vector3d(coors[k][j][i].x,
-                                            coors[k][j][i].y,
-                                            coors[k][j][i].z)                            
+                            gr.getCoord(i, j, k)
                         );
                     if (fabs(dist) > narrowBand) {
                         continue;
@@ -158,9 +146,7 @@ void SphereInitializer::operator ()(Interface<type, dim>& interface, bool initAl
                 for (int j = y; j < y+n; ++j) {
                     for (int k = z; k < z+p; ++k) {
                         data_ptr[k][j][i+1] = sphereEquation(
-                                                Eigen::Vector3d(coors[k][j][i+1].x,
-                                                                coors[k][j][i+1].y,
-                                                                coors[k][j][i+1].z)
+                                                gr.getCoord(i+1, j, k)
                                                 );
                     }
                 }
@@ -173,9 +159,7 @@ void SphereInitializer::operator ()(Interface<type, dim>& interface, bool initAl
                 for (int j = y; j < y+n; ++j) {
                     for (int k = z; k < z+p; ++k) {
                         data_ptr[k][j][i-1] = sphereEquation(
-                                                Eigen::Vector3d(coors[k][j][i-1].x,
-                                                                coors[k][j][i-1].y,
-                                                                coors[k][j][i-1].z)
+                                                gr.getCoord(i-1, j, k)
                                                 );
                     }
                 }
@@ -188,9 +172,7 @@ void SphereInitializer::operator ()(Interface<type, dim>& interface, bool initAl
                 for (int i = x; i < x+m; ++i) {
                     for (int k = z; k < z+p; ++k) {
                         data_ptr[k][j+1][i] = sphereEquation(
-                                                Eigen::Vector3d(coors[k][j+1][i].x,
-                                                                coors[k][j+1][i].y,
-                                                                coors[k][j+1][i].z)
+                                                gr.getCoord(i, j+1, k)
                                                 );
                     }
                 }
@@ -203,9 +185,7 @@ void SphereInitializer::operator ()(Interface<type, dim>& interface, bool initAl
                 for (int i = x; i < x+m; ++i) {
                     for (int k = z; k < z+p; ++k) {
                         data_ptr[k][j-1][i] = sphereEquation(
-                                                Eigen::Vector3d(coors[k][j-1][i].x,
-                                                                coors[k][j-1][i].y,
-                                                                coors[k][j-1][i].z)
+                                                gr.getCoord(i, j-1, k)
                                                 );
                     }
                 }
@@ -218,9 +198,7 @@ void SphereInitializer::operator ()(Interface<type, dim>& interface, bool initAl
                 for (int i = x; i < x+m; ++i) {
                     for (int j = y; j < y+n; ++j) {
                         data_ptr[k+1][j][i] = sphereEquation(
-                                                Eigen::Vector3d(coors[k+1][j][i].x,
-                                                                coors[k+1][j][i].y,
-                                                                coors[k+1][j][i].z)
+                                                gr.getCoord(i, j, k+1)
                                                 );
                     }
                 }
@@ -233,9 +211,7 @@ void SphereInitializer::operator ()(Interface<type, dim>& interface, bool initAl
                 for (int i = x; i < x+m; ++i) {
                     for (int j = y; j < y+n; ++j) {
                         data_ptr[k-1][j][i] = sphereEquation(
-                                                Eigen::Vector3d(coors[k-1][j][i].x,
-                                                                coors[k-1][j][i].y,
-                                                                coors[k-1][j][i].z)
+                                                gr.getCoord(i, j, k-1)
                                                 );
                     }
                 }
@@ -244,7 +220,6 @@ void SphereInitializer::operator ()(Interface<type, dim>& interface, bool initAl
 
     }
 
-    DMDAVecRestoreArray(cda, gc, &coors);
     DMDAVecRestoreArray(gr.getDA(), localData, &data_ptr);
 
 }
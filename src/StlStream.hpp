@@ -0,0 +1,307 @@
+/*
+ * StlStream.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef STLSTREAM_HPP_
+#define STLSTREAM_HPP_
+
+#include <mpi.h>
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <Eigen/Dense>
+
+#include "BoundingBox.hpp"
+#include "FlatGeometry.hpp"
+
+
+/// \brief Reads the part of an STL file in chunks, for meshes which do not fit into memory
+///
+/// The file is split between the parts by bytes (ascii) or by triangles (binary). A facet belongs
+/// to the part holding the first character of its "facet" keyword, so the parts are read in parallel
+/// with no overlap and no scan for the split points. Triangles get their order in the file as ID,
+/// the same as in Geometry::fromFile, once scan counted the triangles of the preceding parts.
+class StlStream {
+
+	FILE*    fp;
+	bool     binary;
+	long int begin, end;  ///< bytes of the part (ascii) or its triangles (binary)
+	long int position;    ///< next byte or triangle to read
+	bool     finished;    ///< no more facets of the part
+
+	long int firstID, nextID;
+	long int localCount;
+
+	std::string line;
+
+	/// reads the next ascii line whole into line, false at the end of the file
+	bool readLine();
+
+	/// reads the next ascii facet of the part
+	bool readFacet(FlatGeometry::Triangle& triangle);
+
+	/// reads the next binary triangle of the part
+	bool readRecord(FlatGeometry::Triangle& triangle);
+
+	static void computeNormal(FlatGeometry::Triangle& triangle);
+
+public:
+
+	/// \param file  ascii or binary STL
+	/// \param part  part read by this rank
+	/// \param parts number of the parts
+	StlStream(const char* file, int part, int parts);
+
+	~StlStream();
+
+	bool good() const {
+		return fp != NULL;
+	}
+
+	/// number of triangles of the part, known after scan
+	long int size() const {
+		return localCount;
+	}
+
+	/// Reads the part once, counts its triangles and numbers them after the preceding parts.
+	/// Collective over comm, the rank of the part has to be its rank in comm.
+	///
+	/// \return aabb of the whole mesh
+	Box<double, 3> scan(MPI_Comm comm);
+
+	/// starts reading the part again
+	void rewind();
+
+	/// reads up to count next triangles of the part, fewer only at its end
+	long int read(long int count, std::vector<FlatGeometry::Triangle>& triangles);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+inline StlStream::StlStream(const char* file, int part, int parts) : binary(false), begin(0), end(0), position(0),
+                                                                     finished(true), firstID(0), nextID(0), localCount(0) {
+
+	fp = fopen(file, "rb");
+	if ( fp == NULL )
+		return;
+
+	fseek(fp, 0, SEEK_END);
+	long int length = ftell(fp);
+
+	// binary has a header of 80 bytes, the number of triangles and 50 bytes per triangle,
+	// an ascii file of exactly that size is not a valid STL
+	uint32_t count = 0;
+	if ( length >= 84 ) {
+		fseek(fp, 80, SEEK_SET);
+		binary = fread(&count, sizeof(count), 1, fp) == 1 && length == 84 + 50 * long(count);
+	}
+
+	long int total = binary ? long(count) : length;
+	begin = total * part / parts;
+	end   = total * (part + 1) / parts;
+
+	rewind();
+
+}
+
+inline StlStream::~StlStream() {
+
+	if ( fp != NULL )
+		fclose(fp);
+
+}
+
+inline void StlStream::rewind() {
+
+	if ( fp == NULL )
+		return;
+
+	position = begin;
+	finished = (begin >= end);
+	nextID   = firstID;
+
+	if ( binary ) {
+		fseek(fp, 84 + 50 * position, SEEK_SET);
+		return;
+	}
+
+	fseek(fp, std::max(begin - 1, 0L), SEEK_SET);
+
+	// a part starting inside a token skips that line, the keyword it may look like belongs to the previous part
+	if ( begin > 0 && !isspace(fgetc(fp)) ) {
+		if ( !readLine() )
+			finished = true;
+		position = ftell(fp);
+	}
+
+}
+
+inline void StlStream::computeNormal(FlatGeometry::Triangle& triangle) {
+
+	Eigen::Vector3d v0(triangle.vertices[0]), v1(triangle.vertices[1]), v2(triangle.vertices[2]);
+	Eigen::Vector3d normal = (v1 - v0).cross(v2 - v0);
+	normal.normalize();
+
+	for (int d = 0; d < 3; ++d) {
+		triangle.normal[d] = normal[d];
+	}
+
+}
+
+inline bool StlStream::readLine() {
+
+	// lines longer than the buffer come in pieces, they are joined up to the newline
+	char buffer[256];
+
+	line.clear();
+	while ( fgets(buffer, sizeof(buffer), fp) != NULL ) {
+		size_t length = strlen(buffer);
+		line.append(buffer, length);
+
+		if ( length == 0 || buffer[length - 1] == '\n' )
+			break;
+	}
+
+	return !line.empty();
+
+}
+
+inline bool StlStream::readFacet(FlatGeometry::Triangle& triangle) {
+
+	while ( !finished ) {
+		long int start = position;
+		if ( !readLine() ) {
+			finished = true;
+			break;
+		}
+		position = ftell(fp);
+
+		long int lead = 0;
+		while ( lead < long(line.size()) && isspace(line[lead]) ) {
+			++lead;
+		}
+
+		if ( line.compare(lead, 5, "facet") != 0 )
+			continue;
+
+		if ( start + lead >= end ) {
+			finished = true;
+			break;
+		}
+
+		// vertices up to the end of the facet, the facet may run past the end of the part
+		int vertex = 0;
+		while ( readLine() ) {
+			position = ftell(fp);
+
+			if ( line.find("endfacet") != std::string::npos )
+				break;
+
+			const char* keyword = strstr(line.c_str(), "vertex");
+			if ( keyword != NULL && vertex < 3 ) {
+				sscanf(keyword, "%*s %lf %lf %lf", &triangle.vertices[vertex][0], &triangle.vertices[vertex][1], &triangle.vertices[vertex][2]);
+				++vertex;
+			}
+		}
+
+		if ( vertex == 3 )
+			return true;
+	}
+
+	return false;
+
+}
+
+inline bool StlStream::readRecord(FlatGeometry::Triangle& triangle) {
+
+	if ( finished )
+		return false;
+
+	unsigned char record[50];
+	if ( fread(record, sizeof(record), 1, fp) != 1 ) {
+		finished = true;
+		return false;
+	}
+
+	// the stored normal is skipped, it is computed from the vertices as for ascii
+	for (int v = 0; v < 3; ++v) {
+		for (int d = 0; d < 3; ++d) {
+			float value;
+			memcpy(&value, record + 12 + 12*v + 4*d, sizeof(value));
+			triangle.vertices[v][d] = value;
+		}
+	}
+
+	finished = (++position >= end);
+
+	return true;
+
+}
+
+inline long int StlStream::read(long int count, std::vector<FlatGeometry::Triangle>& triangles) {
+
+	triangles.clear();
+
+	FlatGeometry::Triangle triangle;
+	while ( long(triangles.size()) < count && (binary ? readRecord(triangle) : readFacet(triangle)) ) {
+		computeNormal(triangle);
+		triangle.ID = nextID++;
+		triangles.push_back(triangle);
+	}
+
+	return triangles.size();
+
+}
+
+inline Box<double, 3> StlStream::scan(MPI_Comm comm) {
+
+	double minX[3], maxX[3];
+	for (int d = 0; d < 3; ++d) {
+		minX[d] =  std::numeric_limits<double>::max();
+		maxX[d] = -std::numeric_limits<double>::max();
+	}
+
+	firstID    = 0;
+	localCount = 0;
+	rewind();
+
+	std::vector<FlatGeometry::Triangle> triangles;
+	while ( read(4096, triangles) > 0 ) {
+		for (auto& triangle: triangles) {
+			for (int v = 0; v < 3; ++v) {
+				for (int d = 0; d < 3; ++d) {
+					minX[d] = std::min(minX[d], triangle.vertices[v][d]);
+					maxX[d] = std::max(maxX[d], triangle.vertices[v][d]);
+				}
+			}
+		}
+		localCount += triangles.size();
+	}
+
+	MPI_Allreduce(MPI_IN_PLACE, minX, 3, MPI_DOUBLE, MPI_MIN, comm);
+	MPI_Allreduce(MPI_IN_PLACE, maxX, 3, MPI_DOUBLE, MPI_MAX, comm);
+
+	int rank;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Exscan(&localCount, &firstID, 1, MPI_LONG, MPI_SUM, comm);
+	if ( rank == 0 )
+		firstID = 0;
+
+	rewind();
+
+	return Box<double, 3>(minX, maxX);
+
+}
+
+#endif /* STLSTREAM_HPP_ */
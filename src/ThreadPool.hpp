@@ -0,0 +1,166 @@
+/*
+ * ThreadPool.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef THREADPOOL_HPP_
+#define THREADPOOL_HPP_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+
+
+/// \brief Threads of one rank for the hybrid MPI + threads runs
+///
+/// One rank per node or NUMA domain keeps one copy of the geometry, the threads share it.
+/// The threads are started once and sleep between the parallel loops. Only the calling thread
+/// talks to MPI and PETSc, so MPI_THREAD_FUNNELED is enough. Loops are scheduled dynamically
+/// in chunks, the calling thread takes part in them.
+class ThreadPool {
+
+	std::vector<std::thread>  workers;
+
+	std::mutex                mutex;
+	std::condition_variable   wake, finished;
+
+	std::function<void(int)>  task;       ///< current loop, called with the thread index
+	long int                  generation; ///< number of loops started, wakes the workers
+	int                       running;    ///< workers still in the current loop
+	bool                      stop;
+
+	void work(int thread);
+
+	/// runs task on all threads and waits for them
+	void run(const std::function<void(int)>& f);
+
+public:
+
+	/// \param nThreads number of threads including the calling one
+	explicit ThreadPool(int nThreads);
+
+	~ThreadPool();
+
+	int size() const {
+		return workers.size() + 1;
+	}
+
+	/// calls f(first, last, thread) on chunks of [begin, end), returns when all are done
+	///
+	/// \param chunk number of iterations taken at once
+	template <typename F>
+	void parallelFor(long int begin, long int end, long int chunk, F f);
+
+	/// parallelFor with no pool runs the loop on the calling thread
+	template <typename F>
+	static void parallelFor(ThreadPool* pool, long int begin, long int end, long int chunk, F f);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+inline ThreadPool::ThreadPool(int nThreads) : generation(0), running(0), stop(false) {
+
+	for (int t = 1; t < nThreads; ++t) {
+		workers.push_back( std::thread(&ThreadPool::work, this, t) );
+	}
+
+}
+
+inline ThreadPool::~ThreadPool() {
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	wake.notify_all();
+
+	for (auto& worker: workers) {
+		worker.join();
+	}
+
+}
+
+inline void ThreadPool::work(int thread) {
+
+	long int seen = 0;
+
+	for (;;) {
+		std::function<void(int)> current;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return stop || generation != seen; });
+			if ( stop )
+				return;
+
+			seen    = generation;
+			current = task;
+		}
+
+		current(thread);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if ( --running == 0 )
+				finished.notify_one();
+		}
+	}
+
+}
+
+inline void ThreadPool::run(const std::function<void(int)>& f) {
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		task    = f;
+		running = workers.size();
+		++generation;
+	}
+	wake.notify_all();
+
+	f(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [&]() { return running == 0; });
+
+}
+
+template <typename F>
+void ThreadPool::parallelFor(long int begin, long int end, long int chunk, F f) {
+
+	if ( end <= begin )
+		return;
+
+	std::atomic<long int> next(begin);
+
+	run( [&](int thread) {
+		for (long int first = next.fetch_add(chunk); first < end; first = next.fetch_add(chunk)) {
+			f(first, std::min(first + chunk, end), thread);
+		}
+	} );
+
+}
+
+template <typename F>
+void ThreadPool::parallelFor(ThreadPool* pool, long int begin, long int end, long int chunk, F f) {
+
+	if ( pool == NULL ) {
+		if ( begin < end )
+			f(begin, end, 0);
+		return;
+	}
+
+	pool->parallelFor(begin, end, chunk, f);
+
+}
+
+#endif /* THREADPOOL_HPP_ */
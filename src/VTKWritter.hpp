@@ -0,0 +1,213 @@
+/*
+ * VTKWritter.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef VTKWRITTER_HPP_
+#define VTKWRITTER_HPP_
+
+#include <petscdmda.h>
+#include <petscsys.h>
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <zlib.h>
+
+#include "Grid.hpp"
+#include "Interface.hpp"
+#include "ThreadPool.hpp"
+
+
+/// \brief Writes the interface as VTK XML image data, one .vti piece per rank and .pvti index.
+///
+/// Every rank writes its own binary piece (raw appended data, optionally zlib compressed)
+/// with no communication but the ghost update, rank 0 adds the .pvti file listing the pieces.
+/// Pieces share one layer of points with their upper neighbors, so ParaView shows no gaps
+/// between them. Files are file.pvti and file_<rank>.vti.
+class VTKWritter {
+
+	/// uncompressed size of one zlib block, as vtkZLibDataCompressor does it
+	static const long int blockSize = 1 << 16;
+
+	/// data of the array with its header, in the layout of vtk appended data,
+	/// the zlib blocks are independent, the threads of the pool compress them
+	static void encode(const std::vector<double>& values, bool compress, std::vector<char>& out, ThreadPool* pool);
+
+	static const char* byteOrder();
+
+public:
+
+	/// \param name     name of the scalar field in ParaView
+	/// \param compress zlib compression of the pieces
+	/// \param pool     threads compressing the piece, NULL compresses on the calling thread
+	template <typename type, int dim>
+	static void writeData(const Interface<type, dim>& data, char* file, const char* name = "phi", bool compress = false, ThreadPool* pool = NULL);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+inline const char* VTKWritter::byteOrder() {
+
+	const uint16_t one = 1;
+
+	return ( *(const char*)&one == 1 ) ? "LittleEndian" : "BigEndian";
+
+}
+
+inline void VTKWritter::encode(const std::vector<double>& values, bool compress, std::vector<char>& out, ThreadPool* pool) {
+
+	const char* raw      = (const char*)values.data();
+	uint64_t    rawBytes = values.size() * sizeof(double);
+
+	out.clear();
+
+	if ( !compress ) {
+		out.insert(out.end(), (const char*)&rawBytes, (const char*)&rawBytes + sizeof(uint64_t));
+		out.insert(out.end(), raw, raw + rawBytes);
+		return;
+	}
+
+	// header is [number of blocks, block size, size of the last block, compressed sizes...]
+	uint64_t nBlocks = (rawBytes + blockSize - 1) / blockSize;
+	std::vector<uint64_t> header(3 + nBlocks);
+	header[0] = nBlocks;
+	header[1] = blockSize;
+	header[2] = (nBlocks > 0) ? rawBytes - (nBlocks - 1) * blockSize : 0;
+
+	std::vector< std::vector<char> > deflated(nBlocks);
+	ThreadPool::parallelFor(pool, 0, nBlocks, 1, [&](long int first, long int last, int) {
+		for (long int b = first; b < last; ++b) {
+			uLong  srcSize = (uint64_t(b) == nBlocks - 1) ? header[2] : blockSize;
+			uLongf dstSize = compressBound(blockSize);
+
+			deflated[b].resize(dstSize);
+			compress2((Bytef*)deflated[b].data(), &dstSize, (const Bytef*)(raw + b*blockSize), srcSize, Z_DEFAULT_COMPRESSION);
+			deflated[b].resize(dstSize);
+
+			header[3 + b] = dstSize;
+		}
+	});
+
+	out.insert(out.end(), (const char*)header.data(), (const char*)(header.data() + header.size()));
+	for (uint64_t b = 0; b < nBlocks; ++b) {
+		out.insert(out.end(), deflated[b].begin(), deflated[b].end());
+	}
+
+}
+
+template <typename type, int dim>
+void VTKWritter::writeData(const Interface<type, dim>& data, char* file, const char* name, bool compress, ThreadPool* pool) {
+
+	int rank, nRanks;
+	const Grid<type, dim>& gr   = data.getGrid();
+	const DMDALocalInfo*   info = gr.getLocalInfo();
+	DM                     da   = gr.getDA();
+
+	MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+	MPI_Comm_size(PETSC_COMM_WORLD, &nRanks);
+
+	// owned block and the first ghost layer above it, which the owners have to refresh first
+	int ext[6] = {info->xs, std::min(info->xs + info->xm, info->mx - 1),
+	              info->ys, std::min(info->ys + info->ym, info->my - 1),
+	              info->zs, std::min(info->zs + info->zm, info->mz - 1)};
+
+	Vec        glob, ghosted;
+	PetscReal* arr;
+
+	DMGetGlobalVector(da, &glob);
+	DMGetLocalVector(da, &ghosted);
+	DMLocalToGlobalBegin(da, data.getLocalData(), INSERT_VALUES, glob);
+	DMLocalToGlobalEnd(da, data.getLocalData(), INSERT_VALUES, glob);
+	DMGlobalToLocalBegin(da, glob, INSERT_VALUES, ghosted);
+	DMGlobalToLocalEnd(da, glob, INSERT_VALUES, ghosted);
+
+	std::vector<double> values;
+	values.reserve( long(ext[1] - ext[0] + 1) * (ext[3] - ext[2] + 1) * (ext[5] - ext[4] + 1) );
+
+	VecGetArray(ghosted, &arr);
+	for (int k = ext[4]; k <= ext[5]; ++k) {
+		for (int j = ext[2]; j <= ext[3]; ++j) {
+			const PetscReal* row = arr + (ext[0] - info->gxs) + (j - info->gys)*long(info->gxm)
+			                           + (k - info->gzs)*long(info->gxm)*info->gym;
+			values.insert(values.end(), row, row + (ext[1] - ext[0] + 1));
+		}
+	}
+	VecRestoreArray(ghosted, &arr);
+
+	DMRestoreLocalVector(da, &ghosted);
+	DMRestoreGlobalVector(da, &glob);
+
+	std::vector<char> appended;
+	encode(values, compress, appended, pool);
+
+	std::string base(file);
+	std::string stem = base;
+	size_t      slash = base.find_last_of('/');
+	if ( slash != std::string::npos ) {
+		stem = base.substr(slash + 1);
+	}
+
+	char pieceName[64];
+
+	snprintf(pieceName, 64, "_%d.vti", rank);
+
+	const char* compressor = compress ? " compressor=\"vtkZLibDataCompressor\"" : "";
+
+	FILE* fp = fopen( (base + pieceName).c_str(), "wb" );
+
+	fprintf(fp, "<?xml version=\"1.0\"?>\n");
+	fprintf(fp, "<VTKFile type=\"ImageData\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\"%s>\n", byteOrder(), compressor);
+	fprintf(fp, "  <ImageData WholeExtent=\"0 %d 0 %d 0 %d\" Origin=\"%.17g %.17g %.17g\" Spacing=\"%.17g %.17g %.17g\">\n",
+	        info->mx - 1, info->my - 1, info->mz - 1,
+	        gr.getMin(0), gr.getMin(1), gr.getMin(2), gr.getDx(0), gr.getDx(1), gr.getDx(2));
+	fprintf(fp, "    <Piece Extent=\"%d %d %d %d %d %d\">\n", ext[0], ext[1], ext[2], ext[3], ext[4], ext[5]);
+	fprintf(fp, "      <PointData Scalars=\"%s\">\n", name);
+	fprintf(fp, "        <DataArray type=\"Float64\" Name=\"%s\" format=\"appended\" offset=\"0\"/>\n", name);
+	fprintf(fp, "      </PointData>\n");
+	fprintf(fp, "    </Piece>\n");
+	fprintf(fp, "  </ImageData>\n");
+	fprintf(fp, "  <AppendedData encoding=\"raw\">\n_");
+	fwrite(appended.data(), 1, appended.size(), fp);
+	fprintf(fp, "\n  </AppendedData>\n");
+	fprintf(fp, "</VTKFile>\n");
+
+	fclose(fp);
+
+	// index of the pieces, their extents are all rank 0 needs to know
+	std::vector<int> extents(rank == 0 ? 6*nRanks : 0);
+	MPI_Gather(ext, 6, MPI_INT, extents.data(), 6, MPI_INT, 0, PETSC_COMM_WORLD);
+
+	if (rank == 0) {
+		fp = fopen( (base + ".pvti").c_str(), "w" );
+
+		fprintf(fp, "<?xml version=\"1.0\"?>\n");
+		fprintf(fp, "<VTKFile type=\"PImageData\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\"%s>\n", byteOrder(), compressor);
+		fprintf(fp, "  <PImageData WholeExtent=\"0 %d 0 %d 0 %d\" GhostLevel=\"0\" Origin=\"%.17g %.17g %.17g\" Spacing=\"%.17g %.17g %.17g\">\n",
+		        info->mx - 1, info->my - 1, info->mz - 1,
+		        gr.getMin(0), gr.getMin(1), gr.getMin(2), gr.getDx(0), gr.getDx(1), gr.getDx(2));
+		fprintf(fp, "    <PPointData Scalars=\"%s\">\n", name);
+		fprintf(fp, "      <PDataArray type=\"Float64\" Name=\"%s\"/>\n", name);
+		fprintf(fp, "    </PPointData>\n");
+		for (int r = 0; r < nRanks; ++r) {
+			const int* e = &extents[6*r];
+			// pieces are next to the index, so the path is relative to it
+			fprintf(fp, "    <Piece Extent=\"%d %d %d %d %d %d\" Source=\"%s_%d.vti\"/>\n",
+			        e[0], e[1], e[2], e[3], e[4], e[5], stem.c_str(), r);
+		}
+		fprintf(fp, "  </PImageData>\n");
+		fprintf(fp, "</VTKFile>\n");
+
+		fclose(fp);
+	}
+
+}
+
+#endif /* VTKWRITTER_HPP_ */
@@ -0,0 +1,135 @@
+/*
+ * WorkQueue.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: petr
+ */
+#pragma once
+#ifndef WORKQUEUE_HPP_
+#define WORKQUEUE_HPP_
+
+#include <mpi.h>
+#include <vector>
+
+
+/// \brief Distributed queue of work items, idle ranks steal the items of the busy ones
+///
+/// Every rank exposes its items and a head counter in RMA windows. Items are claimed by
+/// an atomic fetch and add on the counter of the owner, the owner takes its own items the same way,
+/// so an item is processed exactly once with no help of the owner. When the own items are gone,
+/// the rank goes through the other ranks and claims their items until all counters run out.
+/// Counters only grow, so no termination protocol is needed.
+///
+/// Item has to be trivially copyable, it is read by MPI_Get as bytes.
+/// Construction and destruction are collective over the communicator.
+template <typename Item>
+class WorkQueue {
+
+	MPI_Comm          comm;
+	int               rank, size;
+
+	std::vector<Item> items;   ///< own items, exposed in itemsWin
+	std::vector<int>  counts;  ///< number of items of every rank
+	int               head;    ///< next own item to be claimed, exposed in headWin
+
+	MPI_Win           itemsWin, headWin;
+
+	int               victim;  ///< rank the items are claimed from
+
+	/// claims next item of the rank, false when it has none left
+	bool claim(int target, Item& item, int& index);
+
+public:
+
+	/// \param items own items
+	/// \param comm  communicator of the ranks sharing the work
+	WorkQueue(const std::vector<Item>& items, MPI_Comm comm);
+
+	~WorkQueue();
+
+	/// next item to process, false when there is no work anywhere
+	///
+	/// \param item  claimed item
+	/// \param owner rank owning the item, the results go to it
+	/// \param index index of the item in the owner list
+	bool next(Item& item, int& owner, int& index);
+
+};
+
+
+///===================================
+///          Implementation
+///===================================
+
+template <typename Item>
+WorkQueue<Item>::WorkQueue(const std::vector<Item>& items, MPI_Comm comm) : comm(comm), items(items), head(0) {
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &size);
+
+	int count = this->items.size();
+	counts.resize(size);
+	MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, comm);
+
+	MPI_Win_create(this->items.data(), MPI_Aint(count * sizeof(Item)), 1, MPI_INFO_NULL, comm, &itemsWin);
+	MPI_Win_create(&head, sizeof(int), sizeof(int), MPI_INFO_NULL, comm, &headWin);
+
+	MPI_Win_lock_all(0, itemsWin);
+	MPI_Win_lock_all(0, headWin);
+
+	victim = rank;
+
+}
+
+template <typename Item>
+WorkQueue<Item>::~WorkQueue() {
+
+	MPI_Win_unlock_all(headWin);
+	MPI_Win_unlock_all(itemsWin);
+
+	MPI_Win_free(&headWin);
+	MPI_Win_free(&itemsWin);
+
+}
+
+template <typename Item>
+bool WorkQueue<Item>::claim(int target, Item& item, int& index) {
+
+	// the counter is read even when empty, cheaper than asking first
+	const int one = 1;
+	MPI_Fetch_and_op(&one, &index, MPI_INT, target, 0, MPI_SUM, headWin);
+	MPI_Win_flush(target, headWin);
+
+	if (index >= counts[target])
+		return false;
+
+	if (target == rank) {
+		item = items[index];
+	} else {
+		MPI_Get(&item, sizeof(Item), MPI_BYTE, target, MPI_Aint(index) * sizeof(Item), sizeof(Item), MPI_BYTE, itemsWin);
+		MPI_Win_flush(target, itemsWin);
+	}
+
+	return true;
+
+}
+
+template <typename Item>
+bool WorkQueue<Item>::next(Item& item, int& owner, int& index) {
+
+	// own items first, then the others starting from the next rank, so the thieves spread
+	for (int tried = 0; tried < size; ++tried) {
+		if (counts[victim] > 0 && claim(victim, item, index)) {
+			owner = victim;
+			return true;
+		}
+
+		counts[victim] = 0;
+		victim         = (victim + 1) % size;
+	}
+
+	return false;
+
+}
+
+#endif /* WORKQUEUE_HPP_ */
@@ -10,16 +10,47 @@ static char help[] = "main file launching the whole computation - kind of setup
 #include <iterator>
 #include <Eigen/Dense>
 #include <cassert>
+#include <cstring>
+#include <cstdlib>
 
 #include "Geometry.hpp"
 #include "Grid.hpp"
 #include "Initializer.hpp"
 #include "Interface.hpp"
 #include "FmmWrapper.hpp"
+#include "FastMarching.hpp"
+#include "ClosestPointField.hpp"
 #include "TriangleElement.hpp"
 #include "tictoc.hpp"
 #include "BINWritter.hpp"
+#include "AsyncBINWritter.hpp"
+#include "BandWritter.hpp"
+#include "VTKWritter.hpp"
+#include "IsoSurfaceWritter.hpp"
+#include "ThreadPool.hpp"
+#include "PyramidWritter.hpp"
+#include "Checkpoint.hpp"
+#include "Decomposition.hpp"
+#include "SparseGrid.hpp"
+#include "SparseFastMarching.hpp"
+
+
+
+/// PETSc is started on the group communicator, so MPI is finished here
+static PetscErrorCode finalize() {
+	PetscErrorCode ierr = PetscFinalize();
+	MPI_Finalize();
+	return ierr;
+}
 
+/// -g has to be known before PETSc starts, every group gets its own PETSC_COMM_WORLD
+static int getNumberOfGroups(int argc, char **argv) {
+	for (int i = 1; i < argc - 1; ++i) {
+		if (strcmp(argv[i], "-g") == 0)
+			return std::max(atoi(argv[i + 1]), 1);
+	}
+	return 1;
+}
 
 
 #undef __FUNCT__
@@ -27,6 +58,27 @@ static char help[] = "main file launching the whole computation - kind of setup
 int main(int argc,char **argv) {
 
 	PetscErrorCode ierr;
+
+	// groups compute the same grid, each with its part of the geometry, and merge the band at the end,
+	// only the main thread talks to MPI, the pool threads compute
+	int provided;
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+	int worldRank, worldSize;
+	MPI_Comm_rank(MPI_COMM_WORLD, &worldRank);
+	MPI_Comm_size(MPI_COMM_WORLD, &worldSize);
+
+	int numberOfGroups = getNumberOfGroups(argc, argv);
+	if (worldSize % numberOfGroups != 0) {
+		if (worldRank == 0)
+			std::cerr << "Number of processes has to be divisible by the number of groups!" << std::endl;
+		MPI_Finalize();
+		return 1;
+	}
+
+	int groupID = worldRank / (worldSize / numberOfGroups);
+	MPI_Comm_split(MPI_COMM_WORLD, groupID, worldRank, &PETSC_COMM_WORLD);
+
 	ierr = PetscInitialize(&argc, &argv, (char*)0, help); CHKERRQ(ierr);
 
 
@@ -52,12 +104,20 @@ int main(int argc,char **argv) {
     /// GET OPTIONS ///
     ///////////////////
 
+    char      cname[120];
+    char      rname[120];
+    PetscBool checkpoint, restart;
+
+    // checkpoint the computed field, or restart from one instead of loading the geometry
+    PetscOptionsGetString(PETSC_NULL, "-checkpoint", cname, 120, &checkpoint);
+    PetscOptionsGetString(PETSC_NULL, "-restart", rname, 120, &restart);
+
     PetscOptionsGetString(PETSC_NULL, "-f", fname, 120, &flg);
-    if (!flg) {
+    if (!flg && !restart) {
         // no input filename
         PetscSynchronizedPrintf(PETSC_COMM_WORLD, "C'mon gimme something!\n");
         PetscSynchronizedFlush(PETSC_COMM_WORLD);
-        ierr = PetscFinalize();
+        ierr = finalize();
         return 1;
     }
 
@@ -71,11 +131,11 @@ int main(int argc,char **argv) {
     int M[3], NP[3];
 
     PetscOptionsGetInt(PETSC_NULL,"-m", &M[0], &flg);
-    if (!flg) {
+    if (!flg && !restart) {
         // no input size
         PetscSynchronizedPrintf(PETSC_COMM_WORLD, "At least one dimension must be given!\n");
         PetscSynchronizedFlush(PETSC_COMM_WORLD);
-        ierr = PetscFinalize();
+        ierr = finalize();
         return 1;
     }
 
@@ -110,12 +170,8 @@ int main(int argc,char **argv) {
     }   
 
 
-    int numberOfGroups = 1;
-    PetscOptionsGetInt(PETSC_NULL,"-g", &numberOfGroups, &flg);
-    if (!flg) {
-        // no worry, everything is ok
-        numberOfGroups = 1;
-    }
+    // -g is read before PETSc starts, asked here so it is not reported as unused
+    PetscOptionsHasName(PETSC_NULL, "-g", &flg);
 
     double growCoef = 1.01;
     PetscOptionsGetReal(PETSC_NULL,"-grow", &growCoef, &flg);
@@ -131,12 +187,215 @@ int main(int argc,char **argv) {
 		initAll = 0;
 	}
 
+    int solver = 0; // 0 - LSMLIB, 1 - native fast marching, 2 - native parallel fast marching
+    PetscOptionsGetInt(PETSC_NULL,"-solver", &solver, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        solver = 0;
+    }
+
+    int benchFmm = 0; // run both solvers on the same data and compare them
+    PetscOptionsGetInt(PETSC_NULL,"-bench_fmm", &benchFmm, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        benchFmm = 0;
+    }
+
+    int redistance = 0; // reinitialize the computed field once more, used to time the reinitialization
+    PetscOptionsGetInt(PETSC_NULL,"-redistance", &redistance, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        redistance = 0;
+    }
+
+    int balance = 0; // split the grid by the estimated initialization cost instead of uniformly
+    PetscOptionsGetInt(PETSC_NULL,"-balance", &balance, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        balance = 0;
+    }
+
+    int steal = 0; // idle ranks take over the band and boundary work of the busy ones
+    PetscOptionsGetInt(PETSC_NULL,"-steal", &steal, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        steal = 0;
+    }
+
+    int threads = 1; // threads of every rank, run one rank per node or NUMA domain to keep one geometry copy
+    // they compute the band, the boundaries, the stolen items, the sparse band and the band and VTK bricks,
+    // the fast marching, the checkpoints and the BIN and LSM writers run on the main thread
+    PetscOptionsGetInt(PETSC_NULL,"-threads", &threads, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        threads = 1;
+    }
+
+    int sharedGeometry = 0; // one copy of the geometry and its search tree per node, in MPI shared memory
+    PetscOptionsGetInt(PETSC_NULL,"-shared_geometry", &sharedGeometry, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        sharedGeometry = 0;
+    }
+
+    char      gcname[120];
+    PetscBool geometryCache;
+
+    // keep the loaded geometry and its search tree in a file, repeated runs map it instead of parsing the stl
+    PetscOptionsGetString(PETSC_NULL, "-geometry_cache", gcname, 120, &geometryCache);
+
+    int streamBudget = 0; // MB of triangles in flight per rank, the mesh is streamed and never held whole
+    PetscOptionsGetInt(PETSC_NULL,"-stream", &streamBudget, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        streamBudget = 0;
+    }
+
+    double sparseWidth = 0; // keep only the band of this half width (in dx) in bricks of 8^3 nodes, no dense grid
+    PetscOptionsGetReal(PETSC_NULL,"-sparse", &sparseWidth, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        sparseWidth = 0;
+    }
+
+    if (streamBudget > 0 && size > 1 && solver != 2 && sparseWidth <= 0) {
+        // only the band is initialized, the ranks without the surface get the far field from their neighbors
+        PetscPrintf(PETSC_COMM_WORLD, "Streamed mesh needs the parallel solver, using -solver 2\n");
+        solver = 2;
+    }
+
+    int closestOut = 0; // store closest triangle ID and point, native solvers carry them to the far field
+    PetscOptionsGetInt(PETSC_NULL,"-closest", &closestOut, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        closestOut = 0;
+    }
+
+    int asyncOut = 0; // write in background, the next field is prepared while the previous one is written
+    PetscOptionsGetInt(PETSC_NULL,"-async", &asyncOut, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        asyncOut = 0;
+    }
+
+    double bandWidth = 0; // write the narrow band of this width (in dx) into .band file too
+    PetscOptionsGetReal(PETSC_NULL,"-band", &bandWidth, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        bandWidth = 0;
+    }
+
+    int bandCompression = BAND_RAW; // 0 - raw, 2 - zlib, 4 - 16 bit quantized, 6 - quantized and zlib
+    PetscOptionsGetInt(PETSC_NULL,"-band_compression", &bandCompression, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        bandCompression = BAND_RAW;
+    }
+
+    double bandError = 0; // largest error of the quantized band, 0 gives 1e-4*dx
+    PetscOptionsGetReal(PETSC_NULL,"-band_error", &bandError, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        bandError = 0;
+    }
+
+    int vtkOut = 0; // 1 - ParaView pieces .pvti/.vti, 2 - the same zlib compressed
+    PetscOptionsGetInt(PETSC_NULL,"-vtk", &vtkOut, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        vtkOut = 0;
+    }
+
+    int isoOut = 0; // zero isosurface, 1 - binary .ply, 2 - binary .stl
+    PetscOptionsGetInt(PETSC_NULL,"-iso", &isoOut, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        isoOut = 0;
+    }
+
+    int pyramidLevels = 0; // write 2x, 4x, ... downsampled previews <out>.L1.data, <out>.L2.data, ...
+    PetscOptionsGetInt(PETSC_NULL,"-pyramid", &pyramidLevels, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        pyramidLevels = 0;
+    }
+
+    int writeRepeat = 0; // benchmark of the time series output, write the interface this many times
+    PetscOptionsGetInt(PETSC_NULL,"-write_repeat", &writeRepeat, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        writeRepeat = 0;
+    }
+
+    int writeUncached = 0; // the repeated writes scatter the whole grid to every rank on each call, the old way
+    PetscOptionsGetInt(PETSC_NULL,"-write_uncached", &writeUncached, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        writeUncached = 0;
+    }
+
+    int serialOut = 0; // write .data by rank 0 alone with this slab budget in MB, 0 - collective MPI-IO
+    PetscOptionsGetInt(PETSC_NULL,"-serial_output", &serialOut, &flg);
+    if (!flg) {
+        // no worry, everything is ok
+        serialOut = 0;
+    }
+
     ////////////////////////////
     /// END SETUP PARAMETERS ///
     ////////////////////////////
 
-    int procsPerGroup  = ceil( double(size) / double(numberOfGroups) );
-    int groupID        = rank / procsPerGroup;
+    // all groups end with the same field, only the first one writes it
+    if (groupID != 0) {
+        write_out  = false;
+        checkpoint = PETSC_FALSE;
+    }
+
+    if (restart) {
+        // the grid comes from the checkpoint, the decomposition is up to this run
+        int restart_event;
+        CheckpointHeader header;
+
+        if ( !Checkpoint::readHeader(rname, header) ) {
+            PetscPrintf(PETSC_COMM_WORLD, "%s is not a checkpoint\n", rname);
+            ierr = finalize();
+            return 1;
+        }
+
+        PetscReal bl[3] = {header.bl[0], header.bl[1], header.bl[2]};
+        PetscReal tr[3] = {header.tr[0], header.tr[1], header.tr[2]};
+        PetscInt  dims[3] = {header.dims[0], header.dims[1], header.dims[2]};
+
+        Grid<double, 3>      restartGrid(bl, tr, dims, NP);
+        Interface<double, 3> restarted(restartGrid);
+
+        PetscLogEventRegister("restart", 0, &restart_event);
+        PetscLogEventBegin(restart_event, 0, 0, 0, 0);
+        bool loaded = Checkpoint::load<double,3>(restarted, rname);
+        PetscLogEventEnd(restart_event, 0, 0, 0, 0);
+
+        if (!loaded) {
+            ierr = finalize();
+            return 1;
+        }
+
+        PetscPrintf(PETSC_COMM_WORLD, "restarted %d ranks checkpoint on %d ranks\n", header.nRanks, size);
+
+        if (redistance) {
+            restarted.redistance();
+        }
+
+        if (write_out) {
+            BINWritter::writeData<double,3>(restarted, oname);
+        }
+
+        if (checkpoint) {
+            Checkpoint::save<double,3>(restarted, cname);
+        }
+
+        ierr = finalize();
+        return 0;
+    }
 
     Eigen::Array3d min, max;
 
@@ -147,15 +406,93 @@ int main(int argc,char **argv) {
     PetscLogEventRegister("loadData", 0, &loadData_event);
     PetscLogEventBegin(loadData_event, 0, 0, 0, 0);
 
-    Geometry geom = Geometry::fromFile(fname, growCoef);
+    // streamed mesh is only scanned for its aabb here, all ranks of the world read a part,
+    // the ranks of a group together read the part of the group, every group reads all of it for the sparse grid
+    StlStream* stl = NULL;
+    if (streamBudget > 0) {
+        stl = (sparseWidth > 0) ? new StlStream(fname, rank, size) : new StlStream(fname, worldRank, worldSize);
+        if (!stl->good()) {
+            PetscPrintf(PETSC_COMM_WORLD, "Can not open %s\n", fname);
+            ierr = finalize();
+            return 1;
+        }
+    }
+
+    // the mapped cache is shared by the ranks of the node through the page cache
+    Geometry geom = stl            ? Geometry()
+                  : geometryCache  ? Geometry::fromFileCached(fname, growCoef, gcname, MPI_COMM_WORLD)
+                  : sharedGeometry ? Geometry::fromFileShared(fname, growCoef, MPI_COMM_WORLD)
+                                   : Geometry::fromFile(fname, growCoef);
+
+    if (stl) {
+        geom.aabb = stl->scan(sparseWidth > 0 ? PETSC_COMM_WORLD : MPI_COMM_WORLD);
+        geom.aabb.grow(growCoef);
+    }
+
+    PetscReal gridMin[3] = {geom.aabb.minX(0), geom.aabb.minX(1), geom.aabb.minX(2)};
+    PetscReal gridMax[3] = {geom.aabb.maxX(0), geom.aabb.maxX(1), geom.aabb.maxX(2)};
+
+    ThreadPool* pool = (threads > 1) ? new ThreadPool(threads) : NULL;
+
+    if (sparseWidth > 0) {
+        // the band alone, in leaves allocated near the surface, every group computes it from the whole geometry
+        int         sparse_event;
+        SparseGrid  sparse(gridMin, gridMax, M, sparseWidth);
+        Initializer sparseInit(false, pool);
+
+        PetscLogEventEnd(loadData_event, 0, 0, 0, 0);
+
+        PetscLogEventRegister("sparse", 0, &sparse_event);
+        PetscLogEventBegin(sparse_event, 0, 0, 0, 0);
+
+        if (stl) {
+            sparseInit.stream(*stl, sparse, long(streamBudget) << 20);
+            delete stl;
+        } else {
+            double margin = 3 * std::max(sparse.getDx(0), std::max(sparse.getDx(1), sparse.getDx(2)));
+            geom.initSearchAccelerator();
+            geom.preSortElements(sparse.getNodeSpan(margin), sparse.getDx(0), 1, 0);
+            sparseInit(geom, sparse);
+        }
+
+        int rounds = SparseFastMarching<double>::solveEikonalEquation(sparse);
+
+        PetscLogEventEnd(sparse_event, 0, 0, 0, 0);
+
+        long leaves = sparse.getNumberOfLeaves(), bytes = sparse.memory();
+        MPI_Allreduce(MPI_IN_PLACE, &leaves, 1, MPI_LONG, MPI_SUM, PETSC_COMM_WORLD);
+        MPI_Allreduce(MPI_IN_PLACE, &bytes, 1, MPI_LONG, MPI_SUM, PETSC_COMM_WORLD);
+        PetscPrintf(PETSC_COMM_WORLD, "sparse band: %ld leaves, %g MB, exchange rounds: %d\n", leaves, bytes / 1048576.0, rounds);
+
+        if (write_out) {
+            BandWritter::writeData(sparse, oname, bandWidth > 0 ? bandWidth : sparseWidth, bandCompression, bandError, pool);
+        }
+
+        delete pool;
+        ierr = finalize();
+        return 0;
+    }
+
+    // ownership ranges following the triangles, PETSc splits uniformly without them,
+    // computed from the whole geometry so all groups split the grid the same way
+    std::vector<PetscInt> ranges[3];
+    if (balance && !stl) {
+        Decomposition::balance(geom, gridMin, gridMax, M, NP, ranges);
+    }
+
+    geom.keepGroup(numberOfGroups, groupID);
     geom.initSearchAccelerator();
 
     PetscLogEventEnd(loadData_event, 0, 0, 0, 0);
 
 
     // SphereInitializer init( Eigen::Vector3d(0,0,0), 0.25 );
-    Initializer init;
-    Grid<double, 3>  gr(geom.aabb.bl(), geom.aabb.tr(), M, NP);
+    Initializer init(steal != 0, pool);
+
+    Grid<double, 3>  gr(gridMin, gridMax, M, NP,
+                        ranges[0].empty() ? PETSC_NULL : ranges[0].data(),
+                        ranges[1].empty() ? PETSC_NULL : ranges[1].data(),
+                        ranges[2].empty() ? PETSC_NULL : ranges[2].data());
     // Grid<double, 3>  gr(min, max, tmpM);
 
 
@@ -169,7 +506,14 @@ int main(int argc,char **argv) {
     PetscLogEventRegister("initData", 0, &init_event);
 	PetscLogEventBegin(init_event, 0, 0, 0, 0);
 
-    init(geom, *interface, groupID, numberOfGroups);
+    ClosestPointField* closest = closestOut ? new ClosestPointField() : NULL;
+
+    if (stl) {
+        init.stream(*stl, *interface, long(streamBudget) << 20, groupID, numberOfGroups, closest);
+        delete stl;
+    } else {
+        init(geom, *interface, groupID, numberOfGroups, closest);
+    }
     // init(*interface, initAll);
 
     PetscLogEventEnd(init_event, 0, 0, 0, 0);
@@ -177,28 +521,151 @@ int main(int argc,char **argv) {
 
     double shift = gr.getMaxDist();
 
+    // closest triangle ID and point for every cell, only with -closest
+    Interface<double, 3>* closestID       = NULL;
+    Interface<double, 3>* closestPoint[3] = {NULL, NULL, NULL};
+
     PetscLogEventRegister("solve", 0, &solve_event);
 	PetscLogEventBegin(solve_event, 0, 0, 0, 0);
 
-	if (!initAll) {
+	if (benchFmm) {
+		// both solvers get the same initialized data, time is reported by -log_summary
+		int lsm_event, native_event;
+		Interface<double, 3>* reference = new Interface<double, 3>(gr);
+		VecCopy(interface->getLocalData(), reference->getLocalData());
+
+		PetscLogEventRegister("fmmLSMLIB", 0, &lsm_event);
+		PetscLogEventBegin(lsm_event, 0, 0, 0, 0);
+		FmmWrapper::solveEikonalEquation<3>(gr, reference, shift);
+		PetscLogEventEnd(lsm_event, 0, 0, 0, 0);
+
+		PetscLogEventRegister("fmmNative", 0, &native_event);
+		PetscLogEventBegin(native_event, 0, 0, 0, 0);
+		FastMarching<double>::solveEikonalEquation<3>(gr, interface->getLocalData());
+		PetscLogEventEnd(native_event, 0, 0, 0, 0);
+
+		PetscReal maxDiff;
+		VecAXPY(reference->getLocalData(), -1.0, interface->getLocalData());
+		VecNorm(reference->getLocalData(), NORM_INFINITY, &maxDiff);
+		PetscSynchronizedPrintf(PETSC_COMM_WORLD, "rank %d: max |LSMLIB - native| = %g\n", rank, maxDiff);
+		PetscSynchronizedFlush(PETSC_COMM_WORLD);
+
+		delete reference;
+	} else if (!initAll) {
 		std::cout << "FMM solver" << std::endl;
-		FmmWrapper::solveEikonalEquation<3>(gr, interface, shift);
+
+		std::vector<ExtensionField> extensions;
+		if (closest != NULL) {
+			// dense fields live only for the solve and the output, the band stays sparse
+			closestID = new Interface<double, 3>(gr);
+			for (int d = 0; d < 3; ++d) {
+				closestPoint[d] = new Interface<double, 3>(gr);
+			}
+			Vec pointVecs[3] = {closestPoint[0]->getLocalData(), closestPoint[1]->getLocalData(), closestPoint[2]->getLocalData()};
+			closest->toFields(closestID->getLocalData(), pointVecs);
+			extensions = ClosestPointField::getExtensions(closestID->getLocalData(), pointVecs);
+		}
+
+		if (solver == 2) {
+			int rounds = FastMarching<double>::solveEikonalEquationParallel<3>(gr, interface->getLocalData(), extensions);
+			PetscPrintf(PETSC_COMM_WORLD, "parallel FMM exchange rounds: %d\n", rounds);
+		} else if (solver == 1) {
+			FastMarching<double>::solveEikonalEquation<3>(gr, interface->getLocalData(), extensions);
+		} else {
+			FmmWrapper::solveEikonalEquation<3>(gr, interface, shift);
+		}
 	}
 
 	PetscLogEventEnd(solve_event, 0, 0, 0, 0);
 
+	if (redistance) {
+		int redistance_event;
+		PetscLogEventRegister("redistance", 0, &redistance_event);
+		PetscLogEventBegin(redistance_event, 0, 0, 0, 0);
+		interface->redistance();
+		PetscLogEventEnd(redistance_event, 0, 0, 0, 0);
+	}
+
+    if (checkpoint) {
+        int checkpoint_event;
+        PetscLogEventRegister("checkpoint", 0, &checkpoint_event);
+        PetscLogEventBegin(checkpoint_event, 0, 0, 0, 0);
+        Checkpoint::save<double,3>(*interface, cname);
+        PetscLogEventEnd(checkpoint_event, 0, 0, 0, 0);
+    }
+
+    AsyncBINWritter* writer = asyncOut ? new AsyncBINWritter() : NULL;
+
     if (write_out) {
         // std::cout << "Writting out" << std::endl;
-        BINWritter::writeData<double,3>(*interface, oname);
+        if (writer != NULL) {
+            writer->write<double,3>(*interface, oname);
+        } else if (serialOut > 0) {
+            BINWritter::writeDataSerial<double,3>(*interface, oname, long(serialOut) << 20);
+        } else {
+            BINWritter::writeData<double,3>(*interface, oname);
+        }
+
+        if (closestID != NULL) {
+            const char* suffix[4] = {".id", ".cx", ".cy", ".cz"};
+            Interface<double, 3>* fields[4] = {closestID, closestPoint[0], closestPoint[1], closestPoint[2]};
+            for (int f = 0; f < 4; ++f) {
+                char fieldName[130];
+                snprintf(fieldName, 130, "%s%s", oname, suffix[f]);
+                if (writer != NULL) {
+                    writer->write<double,3>(*fields[f], fieldName);
+                } else {
+                    BINWritter::writeData<double,3>(*fields[f], fieldName);
+                }
+            }
+        }
+        if (vtkOut) {
+            VTKWritter::writeData<double,3>(*interface, oname, "phi", vtkOut == 2, pool);
+        }
+
+        if (pyramidLevels > 0) {
+            PyramidWritter::writeData<double,3>(*interface, oname, pyramidLevels);
+        }
+
+        if (isoOut) {
+            IsoSurfaceWritter::writeData<double,3>(*interface, oname, 0, isoOut == 2 ? ISO_STL : ISO_PLY);
+        }
+
+        if (bandWidth > 0) {
+            BandWritter::writeData<double,3>(*interface, oname, bandWidth, bandCompression, bandError, pool);
+        }
         // std::cout << "write" << std::endl;
     }
 
+    if (write_out && writeRepeat > 0) {
+        int repeat_event;
+        PetscLogEventRegister("writeRepeat", 0, &repeat_event);
+        PetscLogEventBegin(repeat_event, 0, 0, 0, 0);
+        for (int w = 0; w < writeRepeat; ++w) {
+            char stepName[140];
+            snprintf(stepName, 140, "%s.%04d.data", oname, w);
+            interface->writeData(stepName, writeUncached == 0);
+        }
+        PetscLogEventEnd(repeat_event, 0, 0, 0, 0);
+    }
+
+    if (writer != NULL) {
+        int fence_event;
+        PetscLogEventRegister("writeFence", 0, &fence_event);
+        PetscLogEventBegin(fence_event, 0, 0, 0, 0);
+        writer->fence();
+        PetscLogEventEnd(fence_event, 0, 0, 0, 0);
+        delete writer;
+    }
+
+    delete pool;
+
 
 //  delete interface;
 //  delete gr;
 
 
-    ierr = PetscFinalize();
+    ierr = finalize();
     return 0;
 
 }